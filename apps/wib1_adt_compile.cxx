@@ -0,0 +1,61 @@
+/**
+ * @file wib1_adt_compile.cxx
+ *
+ * Flattens WIB1 .adt address tables (with all their includes) into the binary images that
+ * AddressTable loads from $WIBMOD_ADT_CACHE instead of parsing the text files.
+ * Run it once after installing or editing the tables so the first WIB of every process starts fast;
+ * images are also rebuilt on demand whenever a table's files change.
+ */
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+#include "wibmod/WIB1/BUException/ExceptionBase.hh"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+
+static void usage(char const * name){
+  fprintf(stderr,"Usage: %s [-o image] <table.adt> [table.adt ...]\n",name);
+  fprintf(stderr,"  -o  write the image here (one table only), default is the $WIBMOD_ADT_CACHE image path\n");
+}
+
+int main(int argc, char ** argv){
+  std::string output;
+  int opt;
+  while((opt = getopt(argc,argv,"o:h")) != -1){
+    switch(opt){
+    case 'o': output = optarg; break;
+    default:
+      usage(argv[0]);
+      return (opt == 'h') ? 0 : 1;
+    }
+  }
+  int nTables = argc - optind;
+  if(nTables < 1 || (!output.empty() && nTables != 1)){
+    usage(argv[0]);
+    return 1;
+  }
+  if(output.empty() && ParsedAddressTable::ImagePath(argv[optind]).empty()){
+    fprintf(stderr,"Set WIBMOD_ADT_CACHE to the image directory or use -o\n");
+    return 1;
+  }
+
+  int ret = 0;
+  for(int iTable = optind; iTable < argc;iTable++){
+    std::string image = output.empty() ? ParsedAddressTable::ImagePath(argv[iTable]) : output;
+    try{
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      std::shared_ptr<ParsedAddressTable const> table = ParsedAddressTable::Parse(argv[iTable]);
+      double parseTime = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+      table->WriteImage(image);
+      printf("%s: %zu registers from %zu files (parsed in %.1f ms) -> %s\n",
+	     argv[iTable],table->ItemCount(),table->SourceFiles().size(),parseTime,image.c_str());
+    }catch(BUException::exBase & e){
+      fprintf(stderr,"%s: %s\n%s",argv[iTable],e.what(),e.Description());
+      ret = 1;
+    }
+  }
+  return ret;
+}
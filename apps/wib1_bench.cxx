@@ -0,0 +1,372 @@
+/**
+ * @file wib1_bench.cxx
+ *
+ * Microbenchmark for the WIB1 BNL_UDP transport.
+ * Times single register reads against the pipelined bulk read and block write paths,
+ * with and without sendmmsg/recvmmsg batching, and reports packets (words for writes) per second.
+ * The BNL_UDP_Reactor is timed reading from several devices (WIB + FEMB ports) at once.
+ * With -l it instead times register name lookups on the WIB and FEMB address tables,
+ * with -c the slow-control value conversions (per item virtual calls against ItemConversionBatch).
+ * By default it talks to a responder thread on the loopback interface,
+ * use -a to point it at real hardware instead.
+ */
+#include "wibmod/WIB1/BNL_UDP.hh"
+#include "wibmod/WIB1/BNL_UDP_Reactor.hh"
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RESPONDER_BATCH 64
+
+static std::atomic<bool> running(true);
+
+//Loopback stand-in for the WIB: replies to reads with the stored value and acks writes
+static void responder(int sock, std::vector<uint32_t> * registers, bool writePort){
+  uint8_t data[RESPONDER_BATCH][1500];
+  uint8_t reply[RESPONDER_BATCH][12];
+  struct iovec rxIov[RESPONDER_BATCH], txIov[RESPONDER_BATCH];
+  struct mmsghdr rx[RESPONDER_BATCH], tx[RESPONDER_BATCH];
+  struct sockaddr_in from[RESPONDER_BATCH];
+  memset(rx,0,sizeof(rx));
+  memset(tx,0,sizeof(tx));
+  for(size_t i = 0; i < RESPONDER_BATCH;i++){
+    rxIov[i].iov_base = data[i];  rxIov[i].iov_len = sizeof(data[i]);
+    txIov[i].iov_base = reply[i]; txIov[i].iov_len = sizeof(reply[i]);
+    rx[i].msg_hdr.msg_iov = &rxIov[i]; rx[i].msg_hdr.msg_iovlen = 1;
+    rx[i].msg_hdr.msg_name = &from[i];
+    tx[i].msg_hdr.msg_iov = &txIov[i]; tx[i].msg_hdr.msg_iovlen = 1;
+    tx[i].msg_hdr.msg_name = &from[i]; tx[i].msg_hdr.msg_namelen = sizeof(from[i]);
+  }
+  while(running){
+    for(size_t i = 0; i < RESPONDER_BATCH;i++){
+      rx[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+    int n = recvmmsg(sock,rx,RESPONDER_BATCH,MSG_WAITFORONE,NULL);
+    if(n <= 0){
+      continue;
+    }
+    for(int i = 0; i < n;i++){
+      uint8_t * pkt = data[i];
+      size_t words = (writePort && rx[i].msg_len > 6) ? (rx[i].msg_len - 6)/6 : 0;
+      for(size_t iWord = 0; iWord < words;iWord++){
+	uint8_t * w = pkt + 4 + 6*iWord;
+	uint16_t address = uint16_t(w[0] << 8 | w[1]);
+	uint32_t value = (uint32_t(w[2]) << 24) | (uint32_t(w[3]) << 16) | (uint32_t(w[4]) << 8) | w[5];
+	(*registers)[address] = value;
+      }
+      uint16_t address = uint16_t(pkt[4] << 8 | pkt[5]);
+      uint32_t value = (*registers)[address];
+      reply[i][0] = pkt[4];         reply[i][1] = pkt[5];
+      reply[i][2] = value >> 24;    reply[i][3] = value >> 16;
+      reply[i][4] = value >> 8;     reply[i][5] = value;
+      memset(&reply[i][6],0,6);
+    }
+    sendmmsg(sock,tx,n,0);
+  }
+}
+
+static int bind_loopback(uint16_t port){
+  int sock = socket(AF_INET,SOCK_DGRAM,0);
+  struct sockaddr_in addr;
+  memset(&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(bind(sock,(struct sockaddr *) &addr,sizeof(addr)) < 0){
+    fprintf(stderr,"Can't bind 127.0.0.1:%u: %s\n",port,strerror(errno));
+    exit(1);
+  }
+  struct timeval tv; tv.tv_sec = 0; tv.tv_usec = 100000;
+  setsockopt(sock,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+  return sock;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(char const * name, size_t count, double seconds, char const * unit = "packets"){
+  printf("%-32s %10zu %-7s %8.3f s %12.0f %s/s\n",name,count,unit,seconds,count/seconds,unit);
+}
+
+static void usage(char const * name){
+  fprintf(stderr,"Usage: %s [-a address] [-o port_offset] [-n registers] [-r repetitions] [-w window] [-s sessions]\n",name);
+  fprintf(stderr,"       %s -l|-c [-r repetitions] [-t wib_table] [-f femb_table]\n",name);
+  fprintf(stderr,"  -a  WIB address (default: built-in loopback responder)\n");
+  fprintf(stderr,"  -o  port offset (default 0)\n");
+  fprintf(stderr,"  -n  registers per sweep (default 1000)\n");
+  fprintf(stderr,"  -r  sweeps per measurement (default 100)\n");
+  fprintf(stderr,"  -w  read window (default %d)\n",WIB_DEFAULT_READ_WINDOW);
+  fprintf(stderr,"  -s  reactor sessions, at port_offset + 0x10*i (default 5, 0 to skip)\n");
+  fprintf(stderr,"  -l  time name lookups in the address tables instead (-t default WIB.adt, -f default FEMB.adt)\n");
+  fprintf(stderr,"  -c  time slow-control value conversions of the address tables' items instead\n");
+}
+
+//Named lookups through AddressTable against a std::map<std::string,...> keyed the same way
+static int lookup_bench(std::vector<std::string> const & tables, size_t repetitions){
+  try{
+    for(size_t iTable = 0; iTable < tables.size();iTable++){
+      AddressTable table(tables[iTable],"mem://lookup",0);
+      std::vector<std::string> names = table.GetNames();
+      std::map<std::string,Item const *> reference;
+      for(size_t iName = 0; iName < names.size();iName++){
+	reference[names[iName]] = table.GetItem(names[iName]);
+      }
+      printf("%s: %zu names\n",tables[iTable].c_str(),names.size());
+      size_t lookups = names.size()*repetitions;
+      uint64_t check = 0;
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	for(size_t iName = 0; iName < names.size();iName++){
+	  check += table.GetItem(names[iName])->address;
+	}
+      }
+      report("hashed lookup",lookups,seconds_since(start),"lookups");
+
+      start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	for(size_t iName = 0; iName < names.size();iName++){
+	  //by-value std::string, as the named accesses used to take
+	  std::string name(names[iName].c_str());
+	  check -= reference.find(name)->second->address;
+	}
+      }
+      report("std::map lookup",lookups,seconds_since(start),"lookups");
+      if(check != 0){
+	fprintf(stderr,"lookup mismatch\n");
+	return 1;
+      }
+    }
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    return 1;
+  }
+  return 0;
+}
+
+//Converting every slowcontrol item (every item if there are none) one virtual call at a time against a batch
+static int convert_bench(std::vector<std::string> const & tables, size_t repetitions){
+  try{
+    for(size_t iTable = 0; iTable < tables.size();iTable++){
+      AddressTable table(tables[iTable],"mem://convert",0);
+      std::vector<Item const *> items = table.GetTagged("slowcontrol");
+      if(items.empty()){
+	std::vector<std::string> names = table.GetNames();
+	for(size_t iName = 0; iName < names.size();iName++){
+	  items.push_back(table.GetItem(names[iName]));
+	}
+      }
+      ItemConversionBatch batch(items);
+      std::vector<uint32_t> values(items.size());
+      size_t kinds[4] = {0,0,0,0};
+      for(size_t iItem = 0; iItem < items.size();iItem++){
+	//small values, so most enums have a name
+	values[iItem] = (iItem % 16) & (items[iItem]->mask >> items[iItem]->offset);
+	kinds[items[iItem]->sc_conv->GetKind()]++;
+      }
+      printf("%s: %zu items (%zu pass, %zu linear, %zu enum, %zu other), %zu bytes\n",
+	     tables[iTable].c_str(),items.size(),kinds[ItemConversion::PASS],kinds[ItemConversion::LINEAR],
+	     kinds[ItemConversion::ENUM],kinds[ItemConversion::OTHER],batch.OutputSize());
+      std::vector<char> single(batch.OutputSize()),batched(batch.OutputSize());
+      size_t conversions = items.size()*repetitions;
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	for(size_t iItem = 0; iItem < items.size();iItem++){
+	  items[iItem]->sc_conv->Convert(values[iItem],&single[batch.Offset(iItem)]);
+	}
+      }
+      report("per item Convert",conversions,seconds_since(start),"values");
+
+      start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	batch.Convert(values.data(),batched.data());
+      }
+      report("ItemConversionBatch",conversions,seconds_since(start),"values");
+      if(single != batched){
+	fprintf(stderr,"conversion mismatch\n");
+	return 1;
+      }
+    }
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char ** argv){
+  std::string address;
+  uint16_t portOffset = 0;
+  size_t registerCount = 1000;
+  size_t repetitions = 100;
+  size_t window = WIB_DEFAULT_READ_WINDOW;
+  size_t sessionCount = 5;
+  bool lookups = false;
+  bool conversions = false;
+  std::string wibTable = "WIB.adt";
+  std::string fembTable = "FEMB.adt";
+  int opt;
+  while((opt = getopt(argc,argv,"a:o:n:r:w:s:lct:f:h")) != -1){
+    switch(opt){
+    case 'a': address = optarg; break;
+    case 'o': portOffset = strtoul(optarg,NULL,0); break;
+    case 'n': registerCount = strtoul(optarg,NULL,0); break;
+    case 'r': repetitions = strtoul(optarg,NULL,0); break;
+    case 'w': window = strtoul(optarg,NULL,0); break;
+    case 's': sessionCount = strtoul(optarg,NULL,0); break;
+    case 'l': lookups = true; break;
+    case 'c': conversions = true; break;
+    case 't': wibTable = optarg; break;
+    case 'f': fembTable = optarg; break;
+    default:
+      usage(argv[0]);
+      return (opt == 'h') ? 0 : 1;
+    }
+  }
+  if(lookups || conversions){
+    std::vector<std::string> tables;
+    tables.push_back(wibTable);
+    tables.push_back(fembTable);
+    return lookups ? lookup_bench(tables,repetitions) : convert_bench(tables,repetitions);
+  }
+  if(registerCount == 0 || registerCount > 0x10000){
+    fprintf(stderr,"register count must be in 1-65536\n");
+    return 1;
+  }
+
+  if(portOffset + 0x10*((sessionCount > 0) ? sessionCount-1 : 0) > 128){
+    fprintf(stderr,"too many sessions for port offset 0x%X\n",portOffset);
+    return 1;
+  }
+
+  //One register file per device
+  size_t deviceCount = (sessionCount > 1) ? sessionCount : 1;
+  std::vector<std::vector<uint32_t> > registers(deviceCount,std::vector<uint32_t>(0x10000,0));
+  std::vector<std::thread> responders;
+  if(address.empty()){
+    address = "127.0.0.1";
+    //write port then read port
+    for(size_t iDevice = 0; iDevice < deviceCount;iDevice++){
+      uint16_t offset = portOffset + 0x10*iDevice;
+      responders.push_back(std::thread(responder,bind_loopback(32000+offset),&registers[iDevice],true));
+      responders.push_back(std::thread(responder,bind_loopback(32001+offset),&registers[iDevice],false));
+    }
+  }
+
+  try{
+    BNL_UDP udp;
+    udp.Setup(address,portOffset);
+    udp.SetWriteAck(true);
+    udp.SetReadWindow(window);
+
+    std::vector<uint16_t> addresses(registerCount);
+    std::vector<uint32_t> values(registerCount);
+    for(size_t iReg = 0; iReg < registerCount;iReg++){
+      addresses[iReg] = uint16_t(iReg);
+      values[iReg] = uint32_t(iReg*0x10001);
+    }
+    size_t packets = registerCount*repetitions;
+
+    //Single register reads, one round trip each
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t iRep = 0; iRep < repetitions;iRep++){
+      for(size_t iReg = 0; iReg < registerCount;iReg++){
+	udp.ReadWithRetry(addresses[iReg]);
+      }
+    }
+    report("read single",packets,seconds_since(start));
+
+    //Pipelined reads, one send/recv per packet then sendmmsg/recvmmsg
+    for(int batch = 0; batch < 2;batch++){
+      udp.SetBatchSyscalls(batch);
+      start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	udp.ReadWithRetry(addresses);
+      }
+      report(batch ? "read pipelined sendmmsg" : "read pipelined send/recv",packets,seconds_since(start));
+    }
+
+    //Block writes (only meaningful against the responder or a scratch register range)
+    if(!responders.empty()){
+      for(int batch = 0; batch < 2;batch++){
+	udp.SetBatchSyscalls(batch);
+	start = std::chrono::steady_clock::now();
+	for(size_t iRep = 0; iRep < repetitions;iRep++){
+	  udp.Write(0,values);
+	}
+	report(batch ? "block write sendmmsg" : "block write send/recv",
+	       repetitions*registerCount,seconds_since(start),"words");
+      }
+      std::vector<uint32_t> readBack = udp.ReadWithRetry(addresses);
+      if(readBack != values){
+	fprintf(stderr,"Readback mismatch after block writes\n");
+      }
+    }
+    //All devices at once from one reactor thread
+    if(sessionCount > 0){
+      BNL_UDP_Reactor reactor;
+      std::vector<int> sessions;
+      for(size_t iSession = 0; iSession < sessionCount;iSession++){
+	sessions.push_back(reactor.AddSession(address,portOffset + 0x10*iSession));
+	reactor.SetWindow(sessions.back(),window);
+      }
+      std::vector<std::future<std::vector<uint32_t> > > results(sessionCount);
+      start = std::chrono::steady_clock::now();
+      for(size_t iRep = 0; iRep < repetitions;iRep++){
+	for(size_t iSession = 0; iSession < sessionCount;iSession++){
+	  results[iSession] = reactor.Read(sessions[iSession],addresses);
+	}
+	for(size_t iSession = 0; iSession < sessionCount;iSession++){
+	  results[iSession].get();
+	}
+      }
+      char name[64];
+      snprintf(name,sizeof(name),"reactor read, %zu sessions",sessionCount);
+      report(name,packets*sessionCount,seconds_since(start));
+    }
+
+    BNL_UDP_Stats const & stats = udp.GetStats();
+    std::vector<uint64_t> buckets(WIB_LATENCY_BUCKETS,0);
+    stats.read_latency.AddTo(buckets.data());
+    printf("read latency:  p50 %lu us  p99 %lu us  max %lu us\n",
+	   BNL_UDP_LatencyHistogram::Percentile(buckets.data(),0.50),
+	   BNL_UDP_LatencyHistogram::Percentile(buckets.data(),0.99),
+	   stats.read_latency.Max());
+    buckets.assign(WIB_LATENCY_BUCKETS,0);
+    stats.write_latency.AddTo(buckets.data());
+    printf("write latency: p50 %lu us  p99 %lu us  max %lu us\n",
+	   BNL_UDP_LatencyHistogram::Percentile(buckets.data(),0.50),
+	   BNL_UDP_LatencyHistogram::Percentile(buckets.data(),0.99),
+	   stats.write_latency.Max());
+    printf("retries: %lu  timeouts: %lu  stale drains: %lu  packets sent/received: %lu/%lu\n",
+	   stats.retries.load(),stats.timeouts.load(),stats.stale_drains.load(),
+	   stats.packets_sent.load(),stats.packets_received.load());
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    running = false;
+    for(size_t i = 0; i < responders.size();i++){
+      responders[i].join();
+    }
+    return 1;
+  }
+
+  running = false;
+  for(size_t i = 0; i < responders.size();i++){
+    responders[i].join();
+  }
+  return 0;
+}
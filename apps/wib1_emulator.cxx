@@ -0,0 +1,157 @@
+/**
+ * @file wib1_emulator.cxx
+ *
+ * Loopback stand-in for a WIB1 and its FEMBs speaking the BNL_UDP register protocol.
+ * The register files are seeded from the .adt address tables, so WIB/WIBBase code
+ * (and the configurator plugin) can be pointed at 127.0.0.1 and run without hardware.
+ * Latency, jitter and packet loss can be injected to exercise the retry paths.
+ */
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/BNL_UDP_Emulator.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+#include "wibmod/WIB1/RegisterModel.hh"
+
+#include <signal.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int){
+  running = 0;
+}
+
+static void usage(char const * name){
+  fprintf(stderr,"Usage: %s [-t wib_table] [-f femb_table] [-b address] [-F offsets] [-l us] [-j us] [-d rate] [-s NAME=VALUE] [-S NAME=VALUE] [-n]\n",name);
+  fprintf(stderr,"  -t  WIB address table (default WIB.adt)\n");
+  fprintf(stderr,"  -f  FEMB address table (default FEMB.adt)\n");
+  fprintf(stderr,"  -b  address to bind (default 127.0.0.1)\n");
+  fprintf(stderr,"  -F  comma separated FEMB port offsets (default 0x10,0x20,0x30,0x40, \"\" for none)\n");
+  fprintf(stderr,"  -l  reply latency in us (default 0)\n");
+  fprintf(stderr,"  -j  uniform reply jitter in us (default 0)\n");
+  fprintf(stderr,"  -d  fraction of requests to drop (default 0)\n");
+  fprintf(stderr,"  -s  preset a WIB register, may be repeated\n");
+  fprintf(stderr,"  -S  preset a register on every FEMB, may be repeated\n");
+  fprintf(stderr,"  -n  ignore multi-word writes (firmware without block write support)\n");
+}
+
+static std::vector<uint16_t> parse_offsets(std::string const & list){
+  std::vector<uint16_t> offsets;
+  size_t start = 0;
+  while(start < list.size()){
+    size_t end = list.find(',',start);
+    if(end == std::string::npos){
+      end = list.size();
+    }
+    if(end > start){
+      offsets.push_back(strtoul(list.substr(start,end-start).c_str(),NULL,0));
+    }
+    start = end + 1;
+  }
+  return offsets;
+}
+
+//Apply NAME=VALUE presets to a model using the names from table
+static bool preset(RegisterModel & model, AddressTable & table, std::vector<std::string> const & presets){
+  for(size_t i = 0; i < presets.size();i++){
+    size_t eq = presets[i].find('=');
+    if(eq == std::string::npos){
+      fprintf(stderr,"Bad preset \"%s\", expected NAME=VALUE\n",presets[i].c_str());
+      return false;
+    }
+    Item const * item = table.GetItem(presets[i].substr(0,eq));
+    model.Set(item,strtoul(presets[i].substr(eq+1).c_str(),NULL,0));
+  }
+  return true;
+}
+
+int main(int argc, char ** argv){
+  std::string wibTable = "WIB.adt";
+  std::string fembTable = "FEMB.adt";
+  std::string bindAddress = "127.0.0.1";
+  std::string fembOffsets = "0x10,0x20,0x30,0x40";
+  uint32_t latency = 0;
+  uint32_t jitter = 0;
+  double dropRate = 0;
+  bool blockWrite = true;
+  std::vector<std::string> wibPresets;
+  std::vector<std::string> fembPresets;
+  int opt;
+  while((opt = getopt(argc,argv,"t:f:b:F:l:j:d:s:S:nh")) != -1){
+    switch(opt){
+    case 't': wibTable = optarg; break;
+    case 'f': fembTable = optarg; break;
+    case 'b': bindAddress = optarg; break;
+    case 'F': fembOffsets = optarg; break;
+    case 'l': latency = strtoul(optarg,NULL,0); break;
+    case 'j': jitter = strtoul(optarg,NULL,0); break;
+    case 'd': dropRate = strtod(optarg,NULL); break;
+    case 's': wibPresets.push_back(optarg); break;
+    case 'S': fembPresets.push_back(optarg); break;
+    case 'n': blockWrite = false; break;
+    default:
+      usage(argv[0]);
+      return (opt == 'h') ? 0 : 1;
+    }
+  }
+
+  std::vector<uint16_t> offsets = parse_offsets(fembOffsets);
+  //One model per device, each emulator thread owns its own register file
+  std::vector<RegisterModel> models(1 + offsets.size());
+  std::vector<BNL_UDP_Emulator *> emulators;
+  int ret = 0;
+  try{
+    //The tables are only parsed here, so they sit on in-process memory transports rather than sockets
+    AddressTable wib(wibTable,"mem://emulator_wib",0);
+    models[0].Seed(wib);
+    if(!preset(models[0],wib,wibPresets)){
+      return 1;
+    }
+    emulators.push_back(new BNL_UDP_Emulator(models[0],0,bindAddress));
+    if(!offsets.empty()){
+      AddressTable femb(fembTable,"mem://emulator_femb",0);
+      for(size_t iFEMB = 0; iFEMB < offsets.size();iFEMB++){
+	models[iFEMB+1].Seed(femb);
+	if(!preset(models[iFEMB+1],femb,fembPresets)){
+	  ret = 1;
+	  break;
+	}
+	emulators.push_back(new BNL_UDP_Emulator(models[iFEMB+1],offsets[iFEMB],bindAddress));
+      }
+    }
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    ret = 1;
+  }
+
+  if(ret == 0){
+    signal(SIGINT,stop);
+    signal(SIGTERM,stop);
+    for(size_t i = 0; i < emulators.size();i++){
+      emulators[i]->SetLatency(latency,jitter);
+      emulators[i]->SetDropRate(dropRate);
+      emulators[i]->SetBlockWrite(blockWrite);
+      emulators[i]->Start();
+    }
+    printf("Emulating WIB on %s:32000/32001 and %zu FEMB(s), ctrl-c to stop\n",bindAddress.c_str(),offsets.size());
+    while(running){
+      pause();
+    }
+    uint64_t requests = 0;
+    uint64_t drops = 0;
+    for(size_t i = 0; i < emulators.size();i++){
+      emulators[i]->Stop();
+      requests += emulators[i]->GetRequestCount();
+      drops += emulators[i]->GetDropCount();
+    }
+    printf("%lu requests, %lu dropped\n",requests,drops);
+  }
+  for(size_t i = 0; i < emulators.size();i++){
+    delete emulators[i];
+  }
+  return ret;
+}
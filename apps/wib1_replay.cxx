@@ -0,0 +1,261 @@
+/**
+ * @file wib1_replay.cxx
+ *
+ * Tools for WIB1 register transaction logs (written with "?record=<file>" on a WIB address,
+ * or the ProtoWIBConfigurator transaction_log setting).
+ *   dump    print every transaction in time order
+ *   diff    compare the final written value of every register between two logs
+ *   replay  re-issue the logged transactions against a WIB (or the emulator) with no delays.
+ *           A mem:// target is seeded from the address tables (port offset 0 is the WIB, the rest FEMBs)
+ *           so its read-only and action bits behave like the hardware.
+ */
+#include "wibmod/WIB1/TransactionLog.hh"
+#include "wibmod/WIB1/RegisterTransport.hh"
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/BUException/ExceptionBase.hh"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+static void usage(char const * name){
+  fprintf(stderr,"Usage: %s dump <log>\n",name);
+  fprintf(stderr,"       %s diff <log_a> <log_b>\n",name);
+  fprintf(stderr,"       %s [-w] [-v] [-t wib_table] [-f femb_table] replay <log> <address>\n",name);
+  fprintf(stderr,"  -w  replay writes only\n");
+  fprintf(stderr,"  -v  report every read that differs from the log\n");
+  fprintf(stderr,"  -t  WIB address table to seed a mem:// address with (default WIB.adt)\n");
+  fprintf(stderr,"  -f  FEMB address table to seed a mem:// address with (default FEMB.adt)\n");
+}
+
+static bool by_time(TransactionRecord const * a, TransactionRecord const * b){
+  return a->timestamp_ns < b->timestamp_ns;
+}
+
+//Records in time order (chunks from different ports interleave in the file)
+static std::vector<TransactionRecord const *> time_ordered(TransactionLogFile const & log){
+  std::vector<TransactionRecord const *> ordered(log.Count());
+  for(size_t i = 0; i < log.Count();i++){
+    ordered[i] = &log.Records()[i];
+  }
+  std::stable_sort(ordered.begin(),ordered.end(),by_time);
+  return ordered;
+}
+
+static int dump(TransactionLogFile const & log){
+  std::vector<TransactionRecord const *> records = time_ordered(log);
+  uint64_t start = records.empty() ? 0 : records[0]->timestamp_ns;
+  printf("%12s %4s %6s %2s %10s %10s %3s %s\n","time(s)","port","addr","op","value","latency","rty","flags");
+  for(size_t i = 0; i < records.size();i++){
+    TransactionRecord const & r = *records[i];
+    printf("%12.6f 0x%02X 0x%04X %2s 0x%08X %8uus %3u %s%s%s\n",
+	   (r.timestamp_ns - start)*1e-9,r.port_offset,r.address,
+	   (r.op == TransactionRecord::WRITE) ? "W" : "R",
+	   r.value,r.latency_us,r.retries,
+	   (r.flags & TransactionRecord::RETRY) ? "retry " : "",
+	   (r.flags & TransactionRecord::BULK_START) ? "bulk-start " : ((r.flags & TransactionRecord::BULK) ? "bulk " : ""),
+	   (r.flags & TransactionRecord::FAILED) ? "FAILED" : "");
+  }
+  return 0;
+}
+
+struct RegisterHistory{
+  RegisterHistory():writes(0),last(0){};
+  size_t writes;
+  uint32_t last;
+};
+typedef std::map<std::pair<uint16_t,uint16_t>,RegisterHistory> WriteMap;
+
+static WriteMap final_writes(TransactionLogFile const & log){
+  std::vector<TransactionRecord const *> records = time_ordered(log);
+  WriteMap writes;
+  for(size_t i = 0; i < records.size();i++){
+    TransactionRecord const & r = *records[i];
+    if(r.op != TransactionRecord::WRITE || (r.flags & TransactionRecord::FAILED)){
+      continue;
+    }
+    RegisterHistory & history = writes[std::make_pair(r.port_offset,r.address)];
+    history.writes++;
+    history.last = r.value;
+  }
+  return writes;
+}
+
+static int diff(TransactionLogFile const & logA, TransactionLogFile const & logB){
+  WriteMap a = final_writes(logA);
+  WriteMap b = final_writes(logB);
+  //Walk the union of written registers
+  std::map<std::pair<uint16_t,uint16_t>,bool> keys;
+  for(WriteMap::iterator it = a.begin(); it != a.end();it++){keys[it->first] = true;}
+  for(WriteMap::iterator it = b.begin(); it != b.end();it++){keys[it->first] = true;}
+  size_t differences = 0;
+  printf("%4s %6s %10s %6s   %10s %6s\n","port","addr","a","writes","b","writes");
+  for(std::map<std::pair<uint16_t,uint16_t>,bool>::iterator it = keys.begin(); it != keys.end();it++){
+    WriteMap::iterator itA = a.find(it->first);
+    WriteMap::iterator itB = b.find(it->first);
+    if(itA != a.end() && itB != b.end() && itA->second.last == itB->second.last){
+      continue;
+    }
+    differences++;
+    printf("0x%02X 0x%04X ",it->first.first,it->first.second);
+    if(itA != a.end()){
+      printf("0x%08X %6zu   ",itA->second.last,itA->second.writes);
+    }else{
+      printf("%10s %6s   ","-","");
+    }
+    if(itB != b.end()){
+      printf("0x%08X %6zu\n",itB->second.last,itB->second.writes);
+    }else{
+      printf("%10s\n","-");
+    }
+  }
+  printf("%zu of %zu written registers differ\n",differences,keys.size());
+  return (differences == 0) ? 0 : 2;
+}
+
+static int replay(TransactionLogFile const & log, std::string const & address, bool writesOnly, bool verbose,
+		  std::string const & wibTable, std::string const & fembTable){
+  std::vector<TransactionRecord const *> records = time_ordered(log);
+  std::map<uint16_t,RegisterTransport *> transports;
+  //A register file only looks like the device once it knows the table
+  bool seed = (address.compare(0,6,"mem://") == 0);
+  AddressTable * tables[2] = {NULL,NULL};
+  size_t transactions = 0;
+  size_t words = 0;
+  size_t readMismatches = 0;
+  int ret = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try{
+    for(size_t i = 0; i < records.size();){
+      TransactionRecord const & r = *records[i];
+      //Regroup bulk transactions so they go out the same way they were issued
+      size_t count = 1;
+      if(r.flags & TransactionRecord::BULK_START){
+	while(i + count < records.size() &&
+	      (records[i+count]->flags & (TransactionRecord::BULK | TransactionRecord::BULK_START)) == TransactionRecord::BULK &&
+	      records[i+count]->port_offset == r.port_offset &&
+	      records[i+count]->op == r.op){
+	  count++;
+	}
+      }
+      if((r.flags & TransactionRecord::FAILED) || (writesOnly && r.op != TransactionRecord::WRITE)){
+	i += count;
+	continue;
+      }
+      RegisterTransport *& transport = transports[r.port_offset];
+      if(transport == NULL){
+	transport = RegisterTransport::Create(address,r.port_offset);
+	if(seed){
+	  //Port offset 0 is the WIB, the others are FEMBs. The tables are only parsed, on their own registers.
+	  AddressTable *& table = tables[(r.port_offset == 0) ? 0 : 1];
+	  if(table == NULL){
+	    table = new AddressTable((r.port_offset == 0) ? wibTable : fembTable,"mem://replay_table",0);
+	  }
+	  transport->TableLoaded(*table);
+	}
+      }
+      bool retry = r.flags & TransactionRecord::RETRY;
+      if(r.op == TransactionRecord::WRITE){
+	if(count > 1){
+	  std::vector<uint32_t> values(count);
+	  for(size_t iWord = 0; iWord < count;iWord++){
+	    values[iWord] = records[i+iWord]->value;
+	  }
+	  transport->Write(r.address,values);
+	}else if(retry){
+	  transport->WriteWithRetry(r.address,r.value);
+	}else{
+	  transport->Write(r.address,r.value);
+	}
+      }else{
+	std::vector<uint32_t> values;
+	if(count > 1 || (r.flags & TransactionRecord::BULK)){
+	  std::vector<uint16_t> addresses(count);
+	  for(size_t iWord = 0; iWord < count;iWord++){
+	    addresses[iWord] = records[i+iWord]->address;
+	  }
+	  values = retry ? transport->ReadWithRetry(addresses) : transport->Read(addresses);
+	}else{
+	  values.push_back(retry ? transport->ReadWithRetry(r.address) : transport->Read(r.address));
+	}
+	for(size_t iWord = 0; iWord < count;iWord++){
+	  if(values[iWord] != records[i+iWord]->value){
+	    readMismatches++;
+	    if(verbose){
+	      printf("read 0x%02X 0x%04X: logged 0x%08X, now 0x%08X\n",
+		     r.port_offset,records[i+iWord]->address,records[i+iWord]->value,values[iWord]);
+	    }
+	  }
+	}
+      }
+      transactions++;
+      words += count;
+      i += count;
+    }
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    ret = 1;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t logged = records.empty() ? 0 : records.back()->timestamp_ns - records.front()->timestamp_ns;
+  printf("replayed %zu transactions (%zu words) in %.3f s, logged session took %.3f s\n",
+	 transactions,words,seconds,logged*1e-9);
+  printf("%zu reads differ from the log\n",readMismatches);
+  for(std::map<uint16_t,RegisterTransport *>::iterator it = transports.begin(); it != transports.end();it++){
+    delete it->second;
+  }
+  delete tables[0];
+  delete tables[1];
+  return ret;
+}
+
+int main(int argc, char ** argv){
+  bool writesOnly = false;
+  bool verbose = false;
+  std::string wibTable = "WIB.adt";
+  std::string fembTable = "FEMB.adt";
+  int opt;
+  while((opt = getopt(argc,argv,"wvt:f:h")) != -1){
+    switch(opt){
+    case 'w': writesOnly = true; break;
+    case 'v': verbose = true; break;
+    case 't': wibTable = optarg; break;
+    case 'f': fembTable = optarg; break;
+    default:
+      usage(argv[0]);
+      return (opt == 'h') ? 0 : 1;
+    }
+  }
+  int nArgs = argc - optind;
+  if(nArgs < 2){
+    usage(argv[0]);
+    return 1;
+  }
+  std::string command = argv[optind];
+  try{
+    if(command == "dump" && nArgs == 2){
+      TransactionLogFile log(argv[optind+1]);
+      return dump(log);
+    }else if(command == "diff" && nArgs == 3){
+      TransactionLogFile logA(argv[optind+1]);
+      TransactionLogFile logB(argv[optind+2]);
+      return diff(logA,logB);
+    }else if(command == "replay" && nArgs == 3){
+      TransactionLogFile log(argv[optind+1]);
+      return replay(log,argv[optind+2],writesOnly,verbose,wibTable,fembTable);
+    }
+  }catch(BUException::exBase & e){
+    fprintf(stderr,"%s\n%s",e.what(),e.Description());
+    return 1;
+  }
+  usage(argv[0]);
+  return 1;
+}
@@ -116,6 +116,13 @@ ERS_DECLARE_ISSUE_BASE(wibmod,
                        ((std::string)name),
                        ((std::string)message))
 
+ERS_DECLARE_ISSUE_BASE(wibmod,
+                       RegisterWaitTimedOut,
+                       appfwk::GeneralDAQModuleIssue,
+                       "Timed out waiting for " << address << " after " << seconds << " s",
+                       ((std::string)name),
+                       ((std::string)address) ((double)seconds))
+
 ERS_DECLARE_ISSUE(wibmod,
                        WaitingForAlignment,
                        "Waiting for alignment constants from PDTS",
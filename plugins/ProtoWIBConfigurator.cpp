@@ -11,10 +11,12 @@
 #include "wibmod/WIB1/WIBException.hh"
 #include "wibmod/WIB1/BNL_UDP_Exception.hh"
 #include "wibmod/Issues.hpp"
+#include "wibmod/protowibconfiguratorinfo/InfoNljs.hpp"
 
 #include "logging/Logging.hpp"
 
 #include <string>
+#include <algorithm>
 
 /**
  * @brief Name used by TRACE TLOG calls from this source file
@@ -39,6 +41,75 @@ ProtoWIBConfigurator::init(const data_t&)
 {
 }
 
+namespace {
+// Mean and percentiles of the samples added to a merged histogram since the previous report
+template<typename Totals>
+void
+latency_since(const Totals& now, Totals& last, uint64_t& mean, uint64_t& p50, uint64_t& p99)
+{
+  std::vector<uint64_t> delta(now.buckets);
+  if (last.buckets.size() == now.buckets.size() && now.count >= last.count) {
+    for (size_t i = 0; i < delta.size(); ++i) {
+      delta[i] -= std::min(delta[i], last.buckets[i]);
+    }
+    mean = (now.count > last.count) ? (now.sum - last.sum) / (now.count - last.count) : 0;
+  } else {
+    mean = now.count ? now.sum / now.count : 0;
+  }
+  p50 = BNL_UDP_LatencyHistogram::Percentile(delta.data(), 0.50);
+  p99 = BNL_UDP_LatencyHistogram::Percentile(delta.data(), 0.99);
+  last = now;
+}
+} // namespace
+
+void
+ProtoWIBConfigurator::get_info(opmonlib::InfoCollector& ci, int /*level*/)
+{
+  std::lock_guard<std::mutex> lock(wib_mutex);
+  if (!wib) {
+    return;
+  }
+
+  protowibconfiguratorinfo::Info info;
+  LatencyTotals read_latency;
+  LatencyTotals write_latency;
+  read_latency.buckets.assign(WIB_LATENCY_BUCKETS, 0);
+  write_latency.buckets.assign(WIB_LATENCY_BUCKETS, 0);
+  for (int iPort = 0; iPort <= 4; ++iPort) {
+    const BNL_UDP_Stats& stats = (iPort == 0) ? wib->GetTransportStats() : wib->GetFEMBTransportStats(iPort);
+    read_latency.count += stats.read_latency.Count();
+    read_latency.sum += stats.read_latency.Sum();
+    write_latency.count += stats.write_latency.Count();
+    write_latency.sum += stats.write_latency.Sum();
+    info.read_latency_max_us = std::max(info.read_latency_max_us, stats.read_latency.Max());
+    info.write_latency_max_us = std::max(info.write_latency_max_us, stats.write_latency.Max());
+    stats.read_latency.AddTo(read_latency.buckets.data());
+    stats.write_latency.AddTo(write_latency.buckets.data());
+    info.retries += stats.retries.load();
+    info.retries_timeout += stats.retry_timeout.load();
+    info.retries_error += stats.retry_error.load();
+    info.timeouts += stats.timeouts.load();
+    info.bad_address_replies += stats.bad_address.load();
+    info.short_replies += stats.short_replies.load();
+    info.stale_drains += stats.stale_drains.load();
+    info.fail_fast += stats.fail_fast.load();
+    info.block_write_failures += stats.block_write_failures.load();
+    info.per_word_writes += stats.per_word_writes.load();
+    info.packets_sent += stats.packets_sent.load();
+    info.bytes_sent += stats.bytes_sent.load();
+    info.packets_received += stats.packets_received.load();
+    info.bytes_received += stats.bytes_received.load();
+  }
+  info.reads = read_latency.count;
+  info.writes = write_latency.count;
+  latency_since(read_latency, last_read_latency,
+                info.read_latency_mean_us, info.read_latency_p50_us, info.read_latency_p99_us);
+  latency_since(write_latency, last_write_latency,
+                info.write_latency_mean_us, info.write_latency_p50_us, info.write_latency_p99_us);
+
+  ci.add(info);
+}
+
 const protowibconfigurator::FEMBSettings & 
 ProtoWIBConfigurator::femb_conf_i(const protowibconfigurator::WIBSettings &conf, size_t i)
 {
@@ -62,9 +133,20 @@ ProtoWIBConfigurator::do_conf(const data_t& payload)
   const protowibconfigurator::WIBConf &conf = payload.get<protowibconfigurator::WIBConf>();
 
   TLOG_DEBUG(0) << "ProtoWIBConfigurator " << get_name() << " is " << conf.wib_addr;
+
+  std::string wib_addr = conf.wib_addr;
+  if (!conf.transaction_log.empty()) {
+    TLOG_DEBUG(0) << get_name() << " recording register transactions to " << conf.transaction_log;
+    wib_addr += "?record=" + conf.transaction_log;
+  }
   
   try {
-    wib = std::make_unique<WIB>( conf.wib_addr, conf.wib_table, conf.femb_table );
+    std::unique_ptr<WIB> new_wib = std::make_unique<WIB>( wib_addr, conf.wib_table, conf.femb_table );
+    new_wib->EnableShadowRegisters(conf.shadow_registers);
+    std::lock_guard<std::mutex> lock(wib_mutex);
+    wib = std::move(new_wib);
+    last_read_latency = LatencyTotals();
+    last_write_latency = LatencyTotals();
   } catch (BUException::exBase &exc) {
       throw UnhandledBUException(ERS_HERE, get_name(), exc.what(), exc.Description());
   }
@@ -94,6 +176,7 @@ ProtoWIBConfigurator::do_settings(const data_t& payload)
   wib->SetContinueOnFEMBSPIError(conf.continue_on_femb_spi_error);
   wib->SetContinueOnFEMBSyncError(conf.continue_on_femb_sync_error);
   wib->SetContinueIfListOfFEMBClockPhasesDontSync(conf.continue_if_close_phases_dont_sync);
+  wib->SetPDTSPollInterval(conf.pdts_poll_interval);
   
   // Check if WIB firmware is for RCE or FELIX DAQ
   TLOG_DEBUG(0) << "N DAQ Links: "  << wib->Read("SYSTEM.DAQ_LINK_COUNT");
@@ -137,26 +220,31 @@ ProtoWIBConfigurator::do_settings(const data_t& payload)
 
   // Check and print firmware version
   uint32_t expected_wib_fw_version = conf.expected_wib_fw_version;
-  uint32_t wib_fw_version = wib->Read("SYSTEM.FW_VERSION");
+  RegisterSnapshot fw = wib->SnapshotNames({"SYSTEM.FW_VERSION",
+                                            "SYSTEM.SYNTH_DATE.CENTURY","SYSTEM.SYNTH_DATE.YEAR",
+                                            "SYSTEM.SYNTH_DATE.MONTH","SYSTEM.SYNTH_DATE.DAY",
+                                            "SYSTEM.SYNTH_TIME.HOUR","SYSTEM.SYNTH_TIME.MINUTE",
+                                            "SYSTEM.SYNTH_TIME.SECOND"});
+  uint32_t wib_fw_version = fw.Get("SYSTEM.FW_VERSION");
   
   TLOG_DEBUG(0) << "WIB Firmware Version: 0x" 
         << std::hex << std::setw(8) << std::setfill('0')
         <<  wib_fw_version
         << " Synthesized: " 
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_DATE.CENTURY")
+        << fw.Get("SYSTEM.SYNTH_DATE.CENTURY")
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_DATE.YEAR") << "-"
+        << fw.Get("SYSTEM.SYNTH_DATE.YEAR") << "-"
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_DATE.MONTH") << "-"
+        << fw.Get("SYSTEM.SYNTH_DATE.MONTH") << "-"
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_DATE.DAY") << " "
+        << fw.Get("SYSTEM.SYNTH_DATE.DAY") << " "
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_TIME.HOUR") << ":"
+        << fw.Get("SYSTEM.SYNTH_TIME.HOUR") << ":"
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_TIME.MINUTE") << ":"
+        << fw.Get("SYSTEM.SYNTH_TIME.MINUTE") << ":"
         << std::hex << std::setw(2) << std::setfill('0')
-        << wib->Read("SYSTEM.SYNTH_TIME.SECOND");
+        << fw.Get("SYSTEM.SYNTH_TIME.SECOND");
   
   if (expected_wib_fw_version != wib_fw_version)
   {
@@ -167,18 +255,19 @@ ProtoWIBConfigurator::do_settings(const data_t& payload)
   if (conf.force_full_reset)
   {
     TLOG_DEBUG(0) << "Running Full Reset on the WIB";
-    wib->ResetWIBAndCfgDTS(conf.local_clock, conf.partition_number, conf.dts_source);
+    wib->ResetWIBAndCfgDTS(conf.local_clock, conf.partition_number, conf.dts_source, conf.pdts_alignment_timeout);
   }
   else
   {
     TLOG_DEBUG(0) << "Running Checked Reset on the WIB";
-    wib->CheckedResetWIBAndCfgDTS(conf.local_clock, conf.partition_number, conf.dts_source);    
+    wib->CheckedResetWIBAndCfgDTS(conf.local_clock, conf.partition_number, conf.dts_source, conf.pdts_alignment_timeout);    
     TLOG_DEBUG(0) << "Finished Checked Reset on the WIB";
     if (daqMode == WIB::FELIX)
     {                                                  
       TLOG_DEBUG(0) << "SI5342 Status: " << wib->Read("DAQ.SI5342.ENABLE");
     }                                               
   }
+  warn_on_wait_timeouts();
   std::this_thread::sleep_for(std::chrono::seconds(1));
 
   // Check DAQ link copy mode
@@ -239,6 +328,7 @@ ProtoWIBConfigurator::do_settings(const data_t& payload)
     // don't enable links yet if FELIX and start_links_FELIX, do it in start
   TLOG_DEBUG(0) << "Enabling DAQ links " << conf.link1_enabled << " " << conf.link2_enabled << " " << conf.link3_enabled << " " << conf.link4_enabled;
   wib->StartStreamToDAQ(conf.link1_enabled, conf.link2_enabled, conf.link3_enabled, conf.link4_enabled);
+  warn_on_wait_timeouts();
   //}
   
   // Un-set DIM do-not-disturb
@@ -247,6 +337,18 @@ ProtoWIBConfigurator::do_settings(const data_t& payload)
   TLOG_DEBUG(0) << "Configured WIB";
 }
 
+void ProtoWIBConfigurator::warn_on_wait_timeouts()
+{
+  for (const WIB::WaitRecord &wait : wib->GetWaitLog())
+  {
+    if (!wait.met)
+    {
+      ers::warning(RegisterWaitTimedOut(ERS_HERE, get_name(), wait.address, wait.time));
+    }
+  }
+  wib->ClearWaitLog();
+}
+
 void ProtoWIBConfigurator::setup_femb_fake_data(size_t iFEMB, const protowibconfigurator::FEMBSettings& FEMB_conf, bool continue_on_reg_read_error) {
   wib->FEMBPower(iFEMB, 1);
   sleep(5);
@@ -497,6 +599,7 @@ ProtoWIBConfigurator::do_start(const data_t&)
       {
         wib->Write("SYSTEM.SLOW_CONTROL_DND", 1);
         wib->StartStreamToDAQ();
+        warn_on_wait_timeouts();
         success = true;
         break;
       }
@@ -606,6 +709,7 @@ ProtoWIBConfigurator::do_scrap(const data_t&)
                           std::to_string(stop_run_tries) + " tries"));
     }
   } // if felix
+  std::lock_guard<std::mutex> lock(wib_mutex);
   wib = NULL;
   TLOG_DEBUG(0) << get_name() << " successfully scrapped";
 }
@@ -22,6 +22,8 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace dunedaq {
 namespace wibmod {
@@ -46,8 +48,21 @@ public:
 
   void init(const data_t&) override;
 
+  void get_info(opmonlib::InfoCollector& ci, int level) override;
+
 private:
   std::unique_ptr<WIB> wib;
+  std::mutex wib_mutex; ///< Guards replacing wib against get_info
+
+  // Merged latency histograms at the previous get_info, for per-report mean and percentiles
+  struct LatencyTotals
+  {
+    std::vector<uint64_t> buckets;
+    uint64_t sum = 0;
+    uint64_t count = 0;
+  };
+  LatencyTotals last_read_latency;
+  LatencyTotals last_write_latency;
 
   // Commands
   void do_conf(const data_t&);
@@ -60,6 +75,8 @@ private:
   
   void setup_femb_fake_data(size_t iFEMB, const protowibconfigurator::FEMBSettings& FEMB_conf, bool continue_on_reg_read_error);
   void setup_femb(size_t iFEMB, const protowibconfigurator::FEMBSettings& FEMB_conf, bool continue_on_reg_read_error);
+  // Raise a warning for every register wait in the WIB's wait log that timed out, then clear the log
+  void warn_on_wait_timeouts();
 
 };
 
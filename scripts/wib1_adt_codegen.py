@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""Generate compile-time register descriptors from WIB1 .adt address tables.
+
+Each table given as NAMESPACE=FILE becomes a C++ namespace with one type per register,
+nested by the dotted register name, e.g. WIB.adt's DTS.PDTS_STATE becomes
+regs::DTS::PDTS_STATE (with a trailing _ if the name is also a macro, see
+--macro-headers).  The types derive from Register<> (wibmod/WIB1/Register.hh),
+which carries the address, mask, shift and mode as constants and the fingerprint of the
+table they were generated from.  AddressTable uses the constants when the table it loaded
+at runtime has the same fingerprint and falls back to a lookup by name otherwise.
+
+The .adt parsing follows AddressTable's (ProcessLine/LoadFile): '#' comments, space
+separated tokens, include lines nested under the including name and address, names
+upper-cased.  The fingerprint is ParsedAddressTable::Fingerprint's FNV-1a hash and the two
+must be kept in step.
+"""
+
+import argparse
+import io
+import os
+import re
+import sys
+
+MAX_FILE_LEVEL = 10
+READ, WRITE, ACTION = 0x1, 0x2, 0x4
+
+
+def strtoul(token):
+    """C strtoul(token, NULL, 0): the longest valid prefix, 0 if there is none."""
+    match = re.match(r"\s*([+-]?)(0[xX][0-9a-fA-F]+|0[0-7]*|[1-9][0-9]*)", token)
+    if not match:
+        return 0
+    digits = match.group(2)
+    if digits[:2].lower() == "0x":
+        value = int(digits, 16)
+    elif digits.startswith("0"):
+        value = int(digits, 8)
+    else:
+        value = int(digits, 10)
+    if match.group(1) == "-":
+        value = -value
+    return value & 0xFFFFFFFFFFFFFFFF
+
+
+class Table:
+    def __init__(self, directory):
+        self.directory = directory
+        self.items = {}
+        self.sources = []
+        self.level = 0
+
+    def open(self, file_name):
+        for path in (file_name, os.path.join(self.directory, file_name)):
+            if os.path.isfile(path):
+                self.sources.append(path)
+                return open(path, encoding="utf-8", errors="surrogateescape")
+        raise SystemExit("File not found: %s" % file_name)
+
+    def load(self, file_name, prefix="", offset=0):
+        with self.open(file_name) as table_file:
+            for line_number, line in enumerate(table_file, 1):
+                self.process_line(line.rstrip("\r\n"), file_name, line_number, prefix, offset)
+
+    def process_line(self, line, file_name, line_number, prefix, offset):
+        tokens = [token for token in line.split("#", 1)[0].split(" ") if token]
+        if len(tokens) < 3:
+            return
+        name = tokens[0]
+        if prefix:
+            name = prefix + "." + name
+        name = name.rstrip(".").upper()
+        if not name:
+            raise SystemExit("%s:%d: empty name" % (file_name, line_number))
+        address = (strtoul(tokens[1]) + offset) & 0xFFFF
+        if not tokens[2][0].isdigit():
+            self.level += 1
+            if self.level > MAX_FILE_LEVEL:
+                raise SystemExit("%s:%d: include of %s is too deep" % (file_name, line_number, tokens[2]))
+            self.load(" ".join(tokens[2:]), name, address)
+            self.level -= 1
+            return
+        if len(tokens) < 4:
+            return
+        mode = 0
+        if "r" in tokens[3] or "R" in tokens[3]:
+            mode |= READ
+        if "w" in tokens[3] or "W" in tokens[3]:
+            mode |= WRITE
+        if "a" in tokens[3] or "A" in tokens[3]:
+            mode |= ACTION
+        if (mode & WRITE) and (mode & ACTION):
+            raise SystemExit("%s:%d: %s is both WRITE and ACTION" % (file_name, line_number, name))
+        if name in self.items:
+            raise SystemExit("%s:%d: %s already existed" % (file_name, line_number, name))
+        self.items[name] = (address, strtoul(tokens[2]) & 0xFFFFFFFF, mode)
+
+    def fingerprint(self):
+        # 64bit FNV-1a over "NAME address mask mode\n" for every item in name order
+        value = 0xCBF29CE484222325
+        for name in sorted(self.items, key=lambda n: n.encode("utf-8", "surrogateescape")):
+            address, mask, mode = self.items[name]
+            record = "%s %u %u %u\n" % (name, address, mask, mode)
+            for byte in record.encode("utf-8", "surrogateescape"):
+                value ^= byte
+                value = (value * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+        return value
+
+
+def object_macros(directory):
+    """Object-like macros #defined by the headers in directory (e.g. FEMB_COUNT in WIBBase.hh)."""
+    macros = set()
+    for root, _, files in os.walk(directory):
+        for file_name in files:
+            if file_name.endswith((".hh", ".hpp", ".h")):
+                with open(os.path.join(root, file_name), errors="replace") as header:
+                    macros.update(re.findall(r"^\s*#\s*define\s+([A-Za-z_]\w*)\b(?!\()", header.read(), re.M))
+    return macros
+
+
+def identifier(segment, macros):
+    segment = re.sub(r"[^A-Za-z0-9_]", "_", segment)
+    if not segment or segment[0].isdigit():
+        segment = "_" + segment
+    # Would be replaced by the preprocessor wherever the macro is visible
+    if segment in macros:
+        segment += "_"
+    return segment
+
+
+def mode_string(mode):
+    if mode == 0:
+        return "Item::EMPTY"
+    names = []
+    for bit, bit_name in ((READ, "Item::READ"), (WRITE, "Item::WRITE"), (ACTION, "Item::ACTION")):
+        if mode & bit:
+            names.append(bit_name)
+    return "|".join(names)
+
+
+def emit_table(out, namespace, table, macros):
+    # Tree of name segments; a node can be both a register and the parent of others
+    tree = {}
+    for name in table.items:
+        node = tree
+        for segment in name.split("."):
+            node = node.setdefault(identifier(segment, macros), {})
+        node[None] = name
+
+    out.write("namespace %s{\n" % namespace)
+    out.write("  //%u registers from %s\n" % (len(table.items), ", ".join(os.path.basename(s) for s in dict.fromkeys(table.sources))))
+    out.write("  constexpr uint64_t fingerprint = 0x%016XULL;\n" % table.fingerprint())
+
+    def emit(node, indent):
+        pad = "  " * indent
+        for segment in sorted(key for key in node if key is not None):
+            child = node[segment]
+            register = child.get(None)
+            children = [key for key in child if key is not None]
+            if register is not None:
+                address, mask, mode = table.items[register]
+                # A register that is also a prefix (FOO and FOO.BAR) keeps its own name as FOO::self
+                type_name = segment if not children else "self"
+                if children:
+                    out.write("%snamespace %s{\n" % (pad, segment))
+                    inner = pad + "  "
+                else:
+                    inner = pad
+                out.write("%sstruct %s : Register<fingerprint,0x%04X,0x%08X,%s>{static constexpr char const * name = \"%s\";};\n"
+                          % (inner, type_name, address, mask, mode_string(mode), register))
+                if children:
+                    emit(child, indent + 1)
+                    out.write("%s}\n" % pad)
+            else:
+                out.write("%snamespace %s{\n" % (pad, segment))
+                emit(child, indent + 1)
+                out.write("%s}\n" % pad)
+
+    emit(tree, 1)
+    out.write("}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--table-dir", required=True, help="directory holding the .adt files")
+    parser.add_argument("--output", required=True, help="header to write")
+    parser.add_argument("--macro-headers", action="append", default=[], metavar="DIR",
+                        help="append _ to names that are object-like macros in the headers under DIR")
+    parser.add_argument("tables", nargs="+", metavar="NAMESPACE=FILE")
+    args = parser.parse_args()
+
+    macros = set()
+    for directory in args.macro_headers:
+        macros |= object_macros(directory)
+
+    tables = []
+    for spec in args.tables:
+        namespace, _, file_name = spec.partition("=")
+        table = Table(args.table_dir)
+        table.load(file_name)
+        tables.append((namespace, file_name, table))
+
+    guard = "__%s__" % re.sub(r"[^A-Za-z0-9]", "_", os.path.basename(args.output)).upper()
+    out = io.StringIO()
+    out.write("//Generated by scripts/wib1_adt_codegen.py from %s, do not edit\n"
+              % ", ".join(file_name for _, file_name, _ in tables))
+    out.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+    out.write("#include \"wibmod/WIB1/Register.hh\"\n\n")
+    for namespace, _, table in tables:
+        emit_table(out, namespace, table, macros)
+        out.write("\n")
+    out.write("#endif\n")
+    text = out.getvalue()
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "w") as header:
+        header.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -8,9 +8,16 @@
 
 
 AddressTable::AddressTable(std::string const & addressTableName, std::string const & deviceAddress,uint16_t offset){
-  fileLevel = 0;
-  io = new BNL_UDP;
-  io->Setup(deviceAddress,offset);
-  io->SetWriteAck(true);
-  LoadFile(addressTableName);
+  io = NULL;
+  shadowEnabled = false;
+  table = ParsedAddressTable::Get(addressTableName);
+  io = RegisterTransport::Create(deviceAddress,offset);
+  io->TableLoaded(*this);
+}
+
+AddressTable::~AddressTable(){
+  if(io != NULL){
+    delete io;
+    io = NULL;
+  }
 }
@@ -8,124 +8,129 @@
 
 
 uint32_t AddressTable::Read(uint16_t address){
-  return io->Read(address);
+  uint32_t value = io->Read(address);
+  UpdateShadow(address,value);
+  return value;
 }
 uint32_t AddressTable::ReadWithRetry(uint16_t address){
-  return io->ReadWithRetry(address);
+  uint32_t value = io->ReadWithRetry(address);
+  UpdateShadow(address,value);
+  return value;
+}
+std::vector<uint32_t> AddressTable::Read(std::vector<uint16_t> const & addresses){
+  std::vector<uint32_t> values = io->Read(addresses);
+  for(size_t iAddress = 0; shadowEnabled && iAddress < values.size();iAddress++){
+    UpdateShadow(addresses[iAddress],values[iAddress]);
+  }
+  return values;
+}
+std::vector<uint32_t> AddressTable::ReadWithRetry(std::vector<uint16_t> const & addresses){
+  std::vector<uint32_t> values = io->ReadWithRetry(addresses);
+  for(size_t iAddress = 0; shadowEnabled && iAddress < values.size();iAddress++){
+    UpdateShadow(addresses[iAddress],values[iAddress]);
+  }
+  return values;
 }
 
 
 void AddressTable::Write(uint16_t address, uint32_t data){
-  io->Write(address,data);
+  WriteWord(address,data,false);
 }
 void AddressTable::WriteWithRetry(uint16_t address, uint32_t data){
-  io->WriteWithRetry(address,data);
+  WriteWord(address,data,true);
 }
 
 void AddressTable::Write(uint16_t address, std::vector<uint32_t> const & values){
-  io->Write(address,values);
+  Write(address,values.data(),values.size());
 }
 void AddressTable::Write(uint16_t address,uint32_t const * values, size_t word_count){
-  io->Write(address,values,word_count);
+  try{
+    io->Write(address,values,word_count);
+  }catch(...){
+    //Don't know how much of the block made it
+    for(size_t iWord = 0; iWord < word_count;iWord++){
+      shadow.erase(uint16_t(address+iWord));
+    }
+    throw;
+  }
+  for(size_t iWord = 0; shadowEnabled && iWord < word_count;iWord++){
+    UpdateShadow(uint16_t(address+iWord),values[iWord]);
+  }
 }
 
 
-uint32_t AddressTable::Read(std::string registerName){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
-  uint32_t val = io->Read(item->address);
-  val &= (item->mask);
-  val >>= item->offset;
+uint32_t AddressTable::Read(std::string_view registerName){
+  return Read(Resolve(registerName));
+}
+
+uint32_t AddressTable::ReadWithRetry(std::string_view registerName){
+  return ReadWithRetry(Resolve(registerName));
+}
+
+void AddressTable::Write(std::string_view registerName,uint32_t val){
+  Write(Resolve(registerName),val);
+}
+
+void AddressTable::WriteWithRetry(std::string_view registerName,uint32_t val){
+  WriteWithRetry(Resolve(registerName),val);
+}
+
+uint32_t AddressTable::Read(RegisterHandle const & handle){
+  CheckHandle(handle);
+  uint32_t val = Read(handle.address);
+  val &= (handle.mask);
+  val >>= handle.offset;
 
   return val;
 }
 
-uint32_t AddressTable::ReadWithRetry(std::string registerName){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
-  uint32_t val = io->ReadWithRetry(item->address);
-  val &= (item->mask);
-  val >>= item->offset;
+uint32_t AddressTable::ReadWithRetry(RegisterHandle const & handle){
+  CheckHandle(handle);
+  uint32_t val = ReadWithRetry(handle.address);
+  val &= (handle.mask);
+  val >>= handle.offset;
 
   return val;
 }
 
-void AddressTable::Write(std::string registerName,uint32_t val){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
+void AddressTable::Write(RegisterHandle const & handle,uint32_t val){
+  CheckHandle(handle);
   //Check if this entry controls all the bits 
   uint32_t buildingVal =0;
-  if(item->mask != 0xFFFFFFFF){
+  if(handle.mask != 0xFFFFFFFF){
     //Since there are bits this register we don't control, we need to see what they currently are
-    buildingVal = io->Read(item->address);
-    buildingVal &= ~(item->mask);    
+    buildingVal = ReadForWrite(handle.address,false);
+    buildingVal &= ~(handle.mask);    
   }
-  buildingVal |= (item->mask & (val << item->offset));
-  io->Write(item->address,buildingVal);
-}
-
-void AddressTable::WriteWithRetry(std::string registerName,uint32_t val){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
+  buildingVal |= (handle.mask & (val << handle.offset));
+  WriteWord(handle.address,buildingVal,false);
+}
+
+void AddressTable::WriteWithRetry(RegisterHandle const & handle,uint32_t val){
+  CheckHandle(handle);
   //Check if this entry controls all the bits 
   uint32_t buildingVal =0;
-  if(item->mask != 0xFFFFFFFF){
+  if(handle.mask != 0xFFFFFFFF){
     //Since there are bits this register we don't control, we need to see what they currently are
-    buildingVal = io->ReadWithRetry(item->address);
-    buildingVal &= ~(item->mask);    
+    buildingVal = ReadForWrite(handle.address,true);
+    buildingVal &= ~(handle.mask);    
   }
-  buildingVal |= (item->mask & (val << item->offset));
-  io->WriteWithRetry(item->address,buildingVal);
+  buildingVal |= (handle.mask & (val << handle.offset));
+  WriteWord(handle.address,buildingVal,true);
 }
 
 
-void AddressTable::Write(std::string registerName,std::vector<uint32_t> const & values){
+void AddressTable::Write(std::string_view registerName,std::vector<uint32_t> const & values){
   Write(registerName,values.data(),values.size());
 }
-void AddressTable::Write(std::string registerName,uint32_t const * values, size_t word_count){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
+void AddressTable::Write(std::string_view registerName,uint32_t const * values, size_t word_count){
+  Item const * item = table->LookupItem(registerName);
   //Check if this entry controls all the bits 
   if(item->mask != 0xFFFFFFFF){
     BUException::BAD_BLOCK_WRITE e;
     e.Append("Mask is not 0xFFFFFFFF\n");
     throw e;
   }
-  io->Write(item->address,values,word_count);
+  Write(item->address,values,word_count);
 }
 
@@ -5,13 +5,15 @@
 #include <stdlib.h>  //strtoul & getenv
 #include <boost/regex.hpp> //regex
 #include <boost/algorithm/string/case_conv.hpp> //to_upper
+#include <algorithm> //find
 
 
 #define MAX_FILE_LEVEL 10
 
-void AddressTable::LoadFile(std::string const & fileName,
+void ParsedAddressTable::LoadFile(std::string const & fileName,
 			    std::string const & prefix, uint16_t offset){
 
+  std::string openedFileName = fileName;
   std::ifstream inFile(fileName.c_str());
   if (!inFile.is_open()){
     std::string envBasedFileName = fileName;
@@ -28,6 +30,11 @@ void AddressTable::LoadFile(std::string const & fileName,
       e.Append(envBasedFileName.c_str());
       throw e;        
     }
+    openedFileName = envBasedFileName;
+  }
+  //Remember the files this table depends on (for the binary image's staleness check)
+  if(std::find(sourceFiles.begin(),sourceFiles.end(),openedFileName) == sourceFiles.end()){
+    sourceFiles.push_back(openedFileName);
   }
   const size_t bufferSize = 1000;
   char buffer[bufferSize + 1];
@@ -41,7 +48,7 @@ void AddressTable::LoadFile(std::string const & fileName,
 }
 
 
-void AddressTable::ProcessLine(std::string const & line,size_t lineNumber,
+void ParsedAddressTable::ProcessLine(std::string const & line,size_t lineNumber,
 			       std::string const & prefix, uint16_t offset){
   //First, ignore commments
   std::string activeLine = line.substr(0,line.find('#'));
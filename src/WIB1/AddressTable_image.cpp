@@ -0,0 +1,212 @@
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+#include "wibmod/WIB1/AddressTableImage.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+static_assert(sizeof(AddressTableImageHeader) == 32,"address table image header layout changed");
+static_assert(sizeof(AddressTableImageSource) == 16,"address table image source layout changed");
+static_assert(sizeof(AddressTableImageItem) == 24,"address table image item layout changed");
+static_assert(sizeof(AddressTableImageUser) == 8,"address table image user layout changed");
+
+bool ParsedAddressTable::HashFile(std::string const & path, uint64_t & hash){
+  int fd = open(path.c_str(),O_RDONLY);
+  if(fd < 0){
+    return false;
+  }
+  std::string contents;
+  char buffer[4096];
+  ssize_t size;
+  while((size = read(fd,buffer,sizeof(buffer))) > 0){
+    contents.append(buffer,size);
+  }
+  close(fd);
+  if(size < 0){
+    return false;
+  }
+  hash = HashName(contents);
+  return true;
+}
+
+//Builds the string pool, each distinct string is stored once
+class ImageStringPool{
+public:
+  uint32_t Add(std::string const & str){
+    boost::unordered_map<std::string,uint32_t>::iterator it = offsets.find(str);
+    if(it != offsets.end()){
+      return it->second;
+    }
+    uint32_t offset = pool.size();
+    pool.append(str);
+    pool.push_back('\0');
+    offsets[str] = offset;
+    return offset;
+  }
+  std::string const & Data() const {return pool;};
+private:
+  std::string pool;
+  boost::unordered_map<std::string,uint32_t> offsets;
+};
+
+void ParsedAddressTable::WriteImage(std::string const & path) const{
+  ImageStringPool strings;
+  std::vector<AddressTableImageSource> sources(sourceFiles.size());
+  for(size_t iSource = 0; iSource < sourceFiles.size();iSource++){
+    if(!HashFile(sourceFiles[iSource],sources[iSource].hash)){
+      BUException::BAD_FILE e;
+      e.Append("Can't re-read ");
+      e.Append(sourceFiles[iSource].c_str());
+      e.Append(" to hash it\n");
+      throw e;
+    }
+    sources[iSource].path = strings.Add(sourceFiles[iSource]);
+    sources[iSource].reserved = 0;
+  }
+  //Address order, and insertion order within an address, so loading reproduces addressItemMap
+  std::vector<AddressTableImageItem> items;
+  std::vector<AddressTableImageUser> users;
+  for(std::map<uint32_t,std::vector<Item*> >::const_iterator itAddress = addressItemMap.begin();
+      itAddress != addressItemMap.end();
+      itAddress++){
+    std::vector<Item*> const & addressItems = itAddress->second;
+    for(size_t iItem = 0; iItem < addressItems.size();iItem++){
+      Item const * item = addressItems[iItem];
+      AddressTableImageItem imageItem;
+      imageItem.name = strings.Add(item->name);
+      imageItem.mask = item->mask;
+      imageItem.user_begin = users.size();
+      imageItem.user_count = item->user.size();
+      imageItem.address = item->address;
+      imageItem.offset = item->offset;
+      imageItem.mode = item->mode;
+      imageItem.reserved = 0;
+      for(boost::unordered_map<std::string,std::string>::const_iterator itUser = item->user.begin();
+	  itUser != item->user.end();
+	  itUser++){
+	AddressTableImageUser user;
+	user.key = strings.Add(itUser->first);
+	user.value = strings.Add(itUser->second);
+	users.push_back(user);
+      }
+      items.push_back(imageItem);
+    }
+  }
+
+  AddressTableImageHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,WIB_ADDRESS_TABLE_IMAGE_MAGIC,sizeof(header.magic));
+  header.version = WIB_ADDRESS_TABLE_IMAGE_VERSION;
+  header.source_count = sources.size();
+  header.item_count = items.size();
+  header.user_count = users.size();
+  header.string_bytes = strings.Data().size();
+
+  //Write next to the image and rename, so readers never see a partial image
+  char suffix[32];
+  snprintf(suffix,sizeof(suffix),".tmp%d",int(getpid()));
+  std::string tmpPath = path + suffix;
+  FILE * out = fopen(tmpPath.c_str(),"w");
+  if(out == NULL){
+    BUException::BAD_FILE e;
+    e.Append(tmpPath.c_str());
+    e.Append(": ");
+    e.Append(strerror(errno));
+    e.Append("\n");
+    throw e;
+  }
+  bool good = (1 == fwrite(&header,sizeof(header),1,out));
+  good = good && (sources.size() == fwrite(sources.data(),sizeof(AddressTableImageSource),sources.size(),out));
+  good = good && (items.size() == fwrite(items.data(),sizeof(AddressTableImageItem),items.size(),out));
+  good = good && (users.size() == fwrite(users.data(),sizeof(AddressTableImageUser),users.size(),out));
+  good = good && (strings.Data().size() == fwrite(strings.Data().data(),1,strings.Data().size(),out));
+  good = (0 == fclose(out)) && good;
+  if(!good || 0 != rename(tmpPath.c_str(),path.c_str())){
+    unlink(tmpPath.c_str());
+    BUException::BAD_FILE e;
+    e.Append("Failed to write address table image ");
+    e.Append(path.c_str());
+    e.Append("\n");
+    throw e;
+  }
+}
+
+bool ParsedAddressTable::LoadImage(std::string const & path){
+  int fd = open(path.c_str(),O_RDONLY);
+  if(fd < 0){
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd,&st) < 0 || size_t(st.st_size) < sizeof(AddressTableImageHeader)){
+    close(fd);
+    return false;
+  }
+  size_t mapSize = st.st_size;
+  void * map = mmap(NULL,mapSize,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return false;
+  }
+
+  AddressTableImageHeader const * header = (AddressTableImageHeader const *) map;
+  AddressTableImageSource const * sources = (AddressTableImageSource const *) (header + 1);
+  AddressTableImageItem const * items = (AddressTableImageItem const *) (sources + header->source_count);
+  AddressTableImageUser const * users = (AddressTableImageUser const *) (items + header->item_count);
+  char const * strings = (char const *) (users + header->user_count);
+  //Sizes in 64bit so a corrupt count can't wrap
+  uint64_t expectedSize = sizeof(AddressTableImageHeader) +
+    uint64_t(header->source_count)*sizeof(AddressTableImageSource) +
+    uint64_t(header->item_count)*sizeof(AddressTableImageItem) +
+    uint64_t(header->user_count)*sizeof(AddressTableImageUser) +
+    header->string_bytes;
+  bool good = (memcmp(header->magic,WIB_ADDRESS_TABLE_IMAGE_MAGIC,sizeof(header->magic)) == 0 &&
+	       header->version == WIB_ADDRESS_TABLE_IMAGE_VERSION &&
+	       expectedSize == mapSize &&
+	       header->string_bytes > 0 && strings[header->string_bytes-1] == '\0');
+
+  //Every source file must still have the content the image was built from
+  for(uint32_t iSource = 0; good && iSource < header->source_count;iSource++){
+    uint64_t hash;
+    good = (sources[iSource].path < header->string_bytes &&
+	    HashFile(strings + sources[iSource].path,hash) &&
+	    hash == sources[iSource].hash);
+  }
+  for(uint32_t iItem = 0; good && iItem < header->item_count;iItem++){
+    good = (items[iItem].name < header->string_bytes &&
+	    uint64_t(items[iItem].user_begin) + items[iItem].user_count <= header->user_count);
+  }
+  for(uint32_t iUser = 0; good && iUser < header->user_count;iUser++){
+    good = (users[iUser].key < header->string_bytes && users[iUser].value < header->string_bytes);
+  }
+
+  if(good){
+    for(uint32_t iSource = 0; iSource < header->source_count;iSource++){
+      sourceFiles.push_back(strings + sources[iSource].path);
+    }
+    //Straight into the maps, no tokenizing or include handling
+    for(uint32_t iItem = 0; iItem < header->item_count;iItem++){
+      Item * item = new Item;
+      item->name = strings + items[iItem].name;
+      item->address = items[iItem].address;
+      item->mask = items[iItem].mask;
+      item->offset = items[iItem].offset;
+      item->mode = items[iItem].mode;
+      for(uint32_t iUser = items[iItem].user_begin; iUser < items[iItem].user_begin + items[iItem].user_count;iUser++){
+	item->user[strings + users[iUser].key] = strings + users[iUser].value;
+      }
+      try{
+	AddEntry(item);
+      }catch(BUException::exBase &){
+	munmap(map,mapSize);
+	throw;
+      }
+    }
+  }
+  munmap(map,mapSize);
+  return good;
+}
@@ -0,0 +1,107 @@
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+#include <stdio.h>
+
+//Smallest index, grown x2 whenever it gets half full
+#define NAME_INDEX_MIN_SLOTS 64
+
+uint64_t ParsedAddressTable::HashName(std::string_view name){
+  //64bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for(size_t i = 0; i < name.size();i++){
+    hash ^= uint8_t(name[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void ParsedAddressTable::IndexName(Item * item){
+  if(2*(nameIndexCount+1) > nameIndex.size()){
+    //Rehash into twice the slots
+    std::vector<NameSlot> old;
+    old.swap(nameIndex);
+    NameSlot empty = {0,NULL};
+    nameIndex.assign(std::max(size_t(NAME_INDEX_MIN_SLOTS),2*old.size()),empty);
+    nameIndexCount = 0;
+    for(size_t iSlot = 0; iSlot < old.size();iSlot++){
+      if(old[iSlot].item != NULL){
+	IndexName(old[iSlot].item);
+      }
+    }
+  }
+  uint64_t hash = HashName(item->name);
+  size_t mask = nameIndex.size() - 1;
+  size_t iSlot = hash & mask;
+  while(nameIndex[iSlot].item != NULL){
+    iSlot = (iSlot + 1) & mask;
+  }
+  nameIndex[iSlot].hash = hash;
+  nameIndex[iSlot].item = item;
+  nameIndexCount++;
+}
+
+void ParsedAddressTable::ComputeFingerprint(){
+  //"NAME address mask mode\n" for every item in name order, as scripts/wib1_adt_codegen.py does
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  char fields[64];
+  for(std::map<std::string,Item*>::const_iterator it = nameItemMap.begin();
+      it != nameItemMap.end();
+      it++){
+    int size = snprintf(fields,sizeof(fields)," %u %u %u\n",
+			unsigned(it->second->address),unsigned(it->second->mask),unsigned(it->second->mode));
+    std::string_view parts[2] = {it->first,std::string_view(fields,size)};
+    for(size_t iPart = 0; iPart < 2;iPart++){
+      for(size_t i = 0; i < parts[iPart].size();i++){
+	hash ^= uint8_t(parts[iPart][i]);
+	hash *= 0x100000001b3ULL;
+      }
+    }
+  }
+  fingerprint = hash;
+}
+
+Item const * ParsedAddressTable::FindItem(std::string_view name) const{
+  if(nameIndex.empty()){
+    return NULL;
+  }
+  uint64_t hash = HashName(name);
+  size_t mask = nameIndex.size() - 1;
+  for(size_t iSlot = hash & mask; nameIndex[iSlot].item != NULL; iSlot = (iSlot + 1) & mask){
+    if(nameIndex[iSlot].hash == hash && nameIndex[iSlot].item->name == name){
+      return nameIndex[iSlot].item;
+    }
+  }
+  return NULL;
+}
+
+Item const * ParsedAddressTable::LookupItem(std::string_view name) const{
+  Item const * item = FindItem(name);
+  if(item == NULL){
+    BUException::INVALID_NAME e;
+    e.Append("Can't find item with name \"");
+    e.Append(std::string(name).c_str());
+    e.Append("\"");
+    throw e;
+  }
+  return item;
+}
+
+RegisterHandle AddressTable::Resolve(std::string_view name){
+  Item const * item = table->LookupItem(name);
+  RegisterHandle handle;
+  handle.table = this;
+  handle.address = item->address;
+  handle.mask = item->mask;
+  handle.offset = item->offset;
+  handle.mode = item->mode;
+  return handle;
+}
+
+void AddressTable::CheckHandle(RegisterHandle const & handle) const{
+  if(handle.table != this){
+    BUException::INVALID_NAME e;
+    e.Append(handle.Valid() ? "Register handle belongs to a different address table" :
+	                      "Unresolved register handle");
+    throw e;
+  }
+}
@@ -8,20 +8,11 @@
 
 static const char *SC_key_conv = "sc_conv";
 
-Item const * AddressTable::GetItem(std::string const & registerName){
-  std::map<std::string,Item *>::iterator itNameItem = nameItemMap.find(registerName);
-  if(itNameItem == nameItemMap.end()){
-    BUException::INVALID_NAME e;
-    e.Append("Can't find item with name \"");
-    e.Append(registerName.c_str());
-    e.Append("\"");
-    throw e;    
-  }
-  Item * item = itNameItem->second;
-  return item;
+Item const * AddressTable::GetItem(std::string_view registerName){
+  return table->LookupItem(registerName);
 }
 
-void AddressTable::AddEntry(Item * item){
+void ParsedAddressTable::AddEntry(Item * item){
   //Check for null item
   if(item == NULL){
     BUException::NULL_POINTER e;
@@ -79,6 +70,7 @@ void AddressTable::AddEntry(Item * item){
   if(itNameItem == nameItemMap.end()){
     //Add this entry and everything is good. 
     nameItemMap[item->name] = item;
+    IndexName(item);
   }else{
     //There was a collision in entry name, remote the newly added element and throw an exception
     
@@ -108,14 +100,14 @@ void AddressTable::AddEntry(Item * item){
 
   if (item->user.count(SC_key_conv)) {
     std::string convstring = item->user.at(SC_key_conv);
-    item->sc_conv = ItemConversion::FromString(convstring);
+    item->sc_conv = ItemConversion::Get(convstring);
     if (!item->sc_conv) {
       fprintf(stderr, "Warning: Unknown item conversion \"%s\"\n",
         convstring.c_str());
-      item->sc_conv = ItemConversion::FromString("pass");
+      item->sc_conv = ItemConversion::Get("pass");
     }
   } else {
-    item->sc_conv = ItemConversion::FromString("pass");
+    item->sc_conv = ItemConversion::Get("pass");
   }
 
   //Everything is good, we've added it
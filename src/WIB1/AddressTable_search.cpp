@@ -5,12 +5,18 @@
 #include <stdlib.h>  //strtoul & getenv
 #include <boost/regex.hpp> //regex
 #include <boost/algorithm/string/case_conv.hpp> //to_upper
+#include <list>
+#include <mutex>
+#include <set>
 
+//Compiled patterns kept for GetNames/GetTables
+#define REGEX_CACHE_SIZE 64
 
 std::vector<std::string> AddressTable::GetNames(){
   std::vector<std::string > names;
-  for(std::map<std::string,Item*>::iterator it = nameItemMap.begin();
-      it != nameItemMap.end();
+  names.reserve(table->nameItemMap.size());
+  for(std::map<std::string,Item*>::const_iterator it = table->nameItemMap.begin();
+      it != table->nameItemMap.end();
       it++){
     names.push_back(it->first);
   }
@@ -25,37 +31,85 @@ void ReplaceStringInPlace(std::string& subject, const std::string& search,
     pos += replace.length();
   }
 }
-std::vector<std::string> AddressTable::GetNames(std::string const &regex){
-  std::vector<std::string > names;
-  //Fix regex
-  std::string rx = regex;
-  std::transform( rx.begin(), rx.end(), rx.begin(), ::toupper);  
+
+//Convert a search pattern to the regex used for matching.
+//"PERL:" patterns are used unchanged, otherwise '.' is literal and '*' matches anything.
+//literalPrefix is set to the text every match must start with ("" if unknown).
+static std::string SearchRegex(std::string const & pattern, std::string & literalPrefix){
+  std::string rx = pattern;
+  literalPrefix.clear();
   if( rx.size() > 6 && rx.substr(0,5) == "PERL:") {
     printf("Using PERL-style regex unchanged\n");
-    rx = rx.substr( 5);
-  } else {
-    ReplaceStringInPlace( rx, ".", "#");
-    ReplaceStringInPlace( rx, "*",".*");
-    ReplaceStringInPlace( rx, "#","\\.");
+    return rx.substr( 5);
+  }
+  //Characters up to the first one with a special meaning, none at all if there is an alternation
+  if(rx.find('|') == std::string::npos){
+    size_t end = rx.find_first_of("*?+{[()^$\\");
+    literalPrefix = rx.substr(0,end);
+    if(end != std::string::npos && (rx[end] == '?' || rx[end] == '+' || rx[end] == '{') && !literalPrefix.empty()){
+      //The last character is quantified
+      literalPrefix.erase(literalPrefix.size()-1);
+    }
+  }
+  ReplaceStringInPlace( rx, ".", "#");
+  ReplaceStringInPlace( rx, "*",".*");
+  ReplaceStringInPlace( rx, "#","\\.");
+  return rx;
+}
+
+//Small LRU of compiled patterns shared by all tables; slow control re-issues the same queries every cycle
+static std::mutex regexCacheMutex;
+static std::list<std::pair<std::string,std::shared_ptr<boost::regex const> > > regexCache;
+
+static std::shared_ptr<boost::regex const> CompiledRegex(std::string const & rx, char const * caller, std::string const & pattern){
+  {
+    std::lock_guard<std::mutex> lock(regexCacheMutex);
+    for(std::list<std::pair<std::string,std::shared_ptr<boost::regex const> > >::iterator it = regexCache.begin();
+	it != regexCache.end();
+	it++){
+      if(it->first == rx){
+	//Move to the front (most recently used)
+	regexCache.splice(regexCache.begin(),regexCache,it);
+	return regexCache.front().second;
+      }
+    }
   }
-  
   //Create regex match
-  boost::regex re;
+  std::shared_ptr<boost::regex const> re;
   try{
-    re = boost::regex(rx);
+    re = std::make_shared<boost::regex const>(rx);
   }catch(std::exception &e){
     BUException::BAD_REGEX e2;
-    e2.Append("In GetNames: (");
+    e2.Append(caller);
+    e2.Append(": (");
     e2.Append(rx.c_str());
     e2.Append(") ");
-    e2.Append(regex.c_str());
+    e2.Append(pattern.c_str());
     throw e2;
   }
+  std::lock_guard<std::mutex> lock(regexCacheMutex);
+  regexCache.push_front(std::make_pair(rx,re));
+  if(regexCache.size() > REGEX_CACHE_SIZE){
+    regexCache.pop_back();
+  }
+  return re;
+}
+
+std::vector<std::string> AddressTable::GetNames(std::string const &regex){
+  std::vector<std::string > names;
+  //Fix regex
+  std::string upperRegex = regex;
+  std::transform( upperRegex.begin(), upperRegex.end(), upperRegex.begin(), ::toupper);  
+  std::string prefix;
+  std::string rx = SearchRegex(upperRegex,prefix);
+  std::shared_ptr<boost::regex const> re = CompiledRegex(rx,"In GetNames",regex);
+
+  //Only the names starting with the pattern's literal prefix can match
   boost::cmatch match;
-  for(std::map<std::string,Item*>::iterator it = nameItemMap.begin();
-      it != nameItemMap.end();
+  for(std::map<std::string,Item*>::const_iterator it = table->nameItemMap.lower_bound(prefix);
+      it != table->nameItemMap.end() && 0 == it->first.compare(0,prefix.size(),prefix);
       it++){
-    if(regex_match(it->first.c_str(),match,re)){
+    if(regex_match(it->first.c_str(),match,*re)){
       names.push_back(it->first);
     }
   }
@@ -66,13 +120,13 @@ std::vector<std::string> AddressTable::GetNames(std::string const &regex){
 std::vector<std::string> AddressTable::GetAddresses(uint16_t lower,uint16_t upper){
   std::vector<std::string > names;
   //Get an iterator into our map of addresses to vectors of items that is the first entry that is not less than lower
-  std::map<uint32_t,std::vector<Item*> >::iterator itAddress = addressItemMap.lower_bound(lower);
-  for(;itAddress != addressItemMap.end();itAddress++){
+  std::map<uint32_t,std::vector<Item*> >::const_iterator itAddress = table->addressItemMap.lower_bound(lower);
+  for(;itAddress != table->addressItemMap.end();itAddress++){
     //loop over all following address keys
 
     if(itAddress->first < upper){
       //Address key is less than uppper, so add its entries to names
-      std::vector<Item*> & items = itAddress->second;
+      std::vector<Item*> const & items = itAddress->second;
       for(size_t iItem = 0; iItem < items.size();iItem++){
 	names.push_back(items[iItem]->name);
       }
@@ -85,62 +139,47 @@ std::vector<std::string> AddressTable::GetAddresses(uint16_t lower,uint16_t uppe
 }
 
 std::vector<std::string> AddressTable::GetTables(std::string const &regex){
-  
-  //Fix regex
-  std::string rx = regex;
-  //  std::transform( rx.begin(), rx.end(), rx.begin(), ::toupper);  
-  if( rx.size() > 6 && rx.substr(0,5) == "PERL:") {
-    printf("Using PERL-style regex unchanged\n");
-    rx = rx.substr( 5);
-  } else {
-    ReplaceStringInPlace( rx, ".", "#");
-    ReplaceStringInPlace( rx, "*",".*");
-    ReplaceStringInPlace( rx, "#","\\.");
-  }
-  
-  //Create regex match
-  boost::regex re;
-  try{
-    re = boost::regex(rx);
-  }catch(std::exception &e){
-    BUException::BAD_REGEX e2;
-    e2.Append("In GetTables: (");
-    e2.Append(rx.c_str());
-    e2.Append(") ");
-    e2.Append(regex.c_str());
-    throw e2;
-  }
-  std::set<std::string> tableSearch;
+  std::string prefix;
+  std::string rx = SearchRegex(regex,prefix);
+  std::shared_ptr<boost::regex const> re = CompiledRegex(rx,"In GetTables",regex);
+
+  //Match against the distinct table names (sorted) rather than every item
+  std::vector<std::string> tables;
   boost::cmatch match;
-  for(std::map<std::string,Item*>::iterator it = nameItemMap.begin();
-      it != nameItemMap.end();
+  for(std::vector<std::string>::const_iterator it = std::lower_bound(table->tableNames.begin(),table->tableNames.end(),prefix);
+      it != table->tableNames.end() && 0 == it->compare(0,prefix.size(),prefix);
       it++){
-    //Check if this item has a table entry
-    if(it->second->user.find("Table") != it->second->user.end()){
-      std::string const & tableName = it->second->user.find("Table")->second;
-      //check if this table isn't already in the set
-      if(tableSearch.find(tableName) == tableSearch.end()){
-	//Check if we should add it
-	if(regex_match(tableName.c_str(),match,re)){
-	  //Add this table to the set
-	  tableSearch.insert(tableName);         
-	}
-      }
+    if(regex_match(it->c_str(),match,*re)){
+      tables.push_back(*it);
     }
   }
-  std::vector<std::string > tables(tableSearch.begin(),tableSearch.end());
   return tables;
 }
 
 std::vector<const Item *> AddressTable::GetTagged (std::string const &tag) {
-  std::vector<const Item *> matches;
-  for(std::map<std::string,Item*>::iterator it = nameItemMap.begin();
+  boost::unordered_map<std::string,std::vector<Item const *> >::const_iterator it = table->tagIndex.find(tag);
+  if(it == table->tagIndex.end()){
+    return std::vector<const Item *>();
+  }
+  return it->second;
+}
+
+void ParsedAddressTable::BuildSearchIndexes(){
+  std::set<std::string> tables;
+  for(std::map<std::string,Item*>::const_iterator it = nameItemMap.begin();
       it != nameItemMap.end();
       it++){
-    //Check if this item has the tag as an entry
-    if(it->second->user.find(tag) != it->second->user.end()){
-      matches.push_back(it->second);
+    Item const * item = it->second;
+    for(boost::unordered_map<std::string,std::string>::const_iterator itUser = item->user.begin();
+	itUser != item->user.end();
+	itUser++){
+      tagIndex[itUser->first].push_back(item);
+    }
+    //Check if this item has a table entry
+    boost::unordered_map<std::string,std::string>::const_iterator itTable = item->user.find("Table");
+    if(itTable != item->user.end()){
+      tables.insert(itTable->second);
     }
   }
-  return matches;
+  tableNames.assign(tables.begin(),tables.end());
 }
@@ -0,0 +1,76 @@
+#include "wibmod/WIB1/AddressTable.hh"
+
+void ParsedAddressTable::BuildShadowPolicy(){
+  for(std::map<uint32_t,std::vector<Item*> >::const_iterator itAddress = addressItemMap.begin();
+      itAddress != addressItemMap.end();
+      itAddress++){
+    uint32_t pulseMask = 0;
+    bool shadowable = true;
+    std::vector<Item*> const & items = itAddress->second;
+    for(size_t iItem = 0; iItem < items.size();iItem++){
+      if(items[iItem]->user.find("volatile") != items[iItem]->user.end()){
+	//Firmware changes these bits behind our back
+	shadowable = false;
+	break;
+      }
+      if(items[iItem]->mode & Item::ACTION){
+	pulseMask |= items[iItem]->mask;
+      }
+    }
+    if(shadowable){
+      shadowPulseMasks[uint16_t(itAddress->first)] = pulseMask;
+    }
+  }
+}
+
+void AddressTable::EnableShadow(bool enable){
+  shadowEnabled = enable;
+  shadow.clear();
+}
+
+void AddressTable::InvalidateShadow(){
+  shadow.clear();
+}
+
+void AddressTable::InvalidateShadow(uint16_t address){
+  shadow.erase(address);
+}
+
+void AddressTable::UpdateShadow(uint16_t address, uint32_t value){
+  if(!shadowEnabled){
+    return;
+  }
+  boost::unordered_map<uint16_t,uint32_t>::const_iterator itPolicy = table->shadowPulseMasks.find(address);
+  if(itPolicy == table->shadowPulseMasks.end()){
+    return;
+  }
+  //Action bits clear themselves, so they read back as 0
+  shadow[address] = value & ~itPolicy->second;
+}
+
+uint32_t AddressTable::ReadForWrite(uint16_t address, bool retry){
+  if(shadowEnabled){
+    boost::unordered_map<uint16_t,uint32_t>::const_iterator itShadow = shadow.find(address);
+    if(itShadow != shadow.end()){
+      return itShadow->second;
+    }
+  }
+  uint32_t value = retry ? io->ReadWithRetry(address) : io->Read(address);
+  UpdateShadow(address,value);
+  return value;
+}
+
+void AddressTable::WriteWord(uint16_t address, uint32_t value, bool retry){
+  try{
+    if(retry){
+      io->WriteWithRetry(address,value);
+    }else{
+      io->Write(address,value);
+    }
+  }catch(...){
+    //Don't know if the write made it
+    shadow.erase(address);
+    throw;
+  }
+  UpdateShadow(address,value);
+}
@@ -0,0 +1,105 @@
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+#include <boost/algorithm/string/case_conv.hpp> //to_upper
+#include <algorithm>
+
+static bool field_name_less(RegisterSnapshot::Field const & field, std::string_view name){
+  return std::string_view(field.item->name) < name;
+}
+
+RegisterSnapshot::Field const * RegisterSnapshot::Find(std::string_view registerName) const{
+  //Table names are upper case, as in LookupItem
+  std::string name(registerName);
+  boost::algorithm::to_upper(name);
+  std::vector<Field>::const_iterator itField = std::lower_bound(fields.begin(),fields.end(),name,field_name_less);
+  if(itField == fields.end() || itField->item->name != name){
+    return NULL;
+  }
+  return &(*itField);
+}
+
+bool RegisterSnapshot::Has(std::string_view registerName) const{
+  return Find(registerName) != NULL;
+}
+
+uint32_t RegisterSnapshot::Get(std::string_view registerName) const{
+  Field const * field = Find(registerName);
+  if(field == NULL){
+    BUException::INVALID_NAME e;
+    e.Append("\"");
+    e.Append(std::string(registerName).c_str());
+    e.Append("\" is not in this snapshot");
+    throw e;
+  }
+  return field->value;
+}
+
+RegisterSnapshot AddressTable::Snapshot(std::string const & prefix, bool retry){
+  std::string name(prefix);
+  boost::algorithm::to_upper(name);
+  std::vector<Item const *> items;
+  for(std::map<std::string,Item*>::const_iterator it = table->nameItemMap.lower_bound(name);
+      it != table->nameItemMap.end() && it->first.compare(0,name.size(),name) == 0;
+      it++){
+    //Only prefix itself and the names below it, "DTS.CDS" doesn't match "DTS.CDS_X"
+    if(!name.empty() && it->first.size() > name.size() && it->first[name.size()] != '.'){
+      continue;
+    }
+    if(it->second->mode & Item::READ){
+      items.push_back(it->second);
+    }
+  }
+  return SnapshotItems(items,retry);
+}
+
+RegisterSnapshot AddressTable::SnapshotTagged(std::string const & tag, bool retry){
+  std::vector<Item const *> items;
+  boost::unordered_map<std::string,std::vector<Item const *> >::const_iterator itTag = table->tagIndex.find(tag);
+  if(itTag != table->tagIndex.end()){
+    for(size_t iItem = 0; iItem < itTag->second.size();iItem++){
+      if(itTag->second[iItem]->mode & Item::READ){
+	items.push_back(itTag->second[iItem]);
+      }
+    }
+  }
+  return SnapshotItems(items,retry);
+}
+
+RegisterSnapshot AddressTable::SnapshotNames(std::vector<std::string> const & names, bool retry){
+  std::vector<Item const *> items;
+  items.reserve(names.size());
+  for(size_t iName = 0; iName < names.size();iName++){
+    items.push_back(table->LookupItem(names[iName]));
+  }
+  return SnapshotItems(items,retry);
+}
+
+static bool item_name_less(Item const * a, Item const * b){
+  return a->name < b->name;
+}
+
+RegisterSnapshot AddressTable::SnapshotItems(std::vector<Item const *> items, bool retry){
+  RegisterSnapshot snapshot;
+  std::sort(items.begin(),items.end(),item_name_less);
+  items.erase(std::unique(items.begin(),items.end()),items.end());
+
+  //Every register once, in address order
+  for(size_t iItem = 0; iItem < items.size();iItem++){
+    snapshot.addresses.push_back(items[iItem]->address);
+  }
+  std::sort(snapshot.addresses.begin(),snapshot.addresses.end());
+  snapshot.addresses.erase(std::unique(snapshot.addresses.begin(),snapshot.addresses.end()),snapshot.addresses.end());
+  if(!snapshot.addresses.empty()){
+    snapshot.words = retry ? ReadWithRetry(snapshot.addresses) : Read(snapshot.addresses);
+  }
+
+  //Decode the fields from the words
+  snapshot.fields.resize(items.size());
+  for(size_t iItem = 0; iItem < items.size();iItem++){
+    size_t iWord = std::lower_bound(snapshot.addresses.begin(),snapshot.addresses.end(),items[iItem]->address) -
+      snapshot.addresses.begin();
+    snapshot.fields[iItem].item = items[iItem];
+    snapshot.fields[iItem].value = (snapshot.words[iWord] & items[iItem]->mask) >> items[iItem]->offset;
+  }
+  return snapshot;
+}
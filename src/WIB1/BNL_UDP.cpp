@@ -1,10 +1,14 @@
 #include "wibmod/WIB1/BNL_UDP.hh"
 #include "wibmod/WIB1/BNL_UDP_Exception.hh"
+#include "wibmod/WIB1/BNL_UDP_Protocol.hh"
+#include "wibmod/WIB1/AddressTable.hh"
 #include <sys/socket.h>
 #include <string.h> //memset, strerror
 #include <errno.h>
 #include <string>
 #include <fcntl.h> //fcntl
+#include <poll.h> //ppoll
+#include <time.h> //clock_gettime
 
 #include <sstream>
 #include <iomanip>
@@ -12,27 +16,16 @@
 #include <netdb.h>
 
 #include <errno.h>
-#include <algorithm> //STD::COUNT
+#include <algorithm> //STD::COUNT, std::min
+#include <stdio.h> //snprintf
+#include <deque>
+#include <boost/unordered_map.hpp>
 
-#define WIB_WR_BASE_PORT 32000
-#define WIB_RD_BASE_PORT 32001
-#define WIB_RPLY_BASE_PORT 32002
+//Receive slot size in the recvmmsg arena (only the first 6 bytes of a reply are used)
+#define WIB_RPLY_ARENA_SLOT_SIZE 64
 
-#define WIB_PACKET_KEY 0xDEADBEEF
-//#define WIB_REQUEST_PACKET_SIZE (4+2+4+2)
-#define WIB_REQUEST_PACKET_TRAILER 0xFFFF
-
-#define WIB_RPLY_PACKET_SIZE 12
-
-#define TIMEOUT_SECONDS 2
-#define TIMEOUT_MICROSECONDS 0
-struct WIB_packet_t{
-  uint32_t key;
-  uint32_t reg_addr : 16;
-  uint32_t data_MSW : 16;
-  uint32_t data_LSW : 16;
-  uint32_t trailer  : 16;
-};
+//Unanswered two word blocks before a remote that answers single writes is taken to lack block writes
+#define WIB_BLOCK_WRITE_PROBE_TRIES 3
 
 static std::string dump_packet(uint8_t * data, size_t size){
   //  printf("Err: %p %zu\n",data,size);
@@ -50,14 +43,212 @@ static std::string dump_packet(uint8_t * data, size_t size){
   return ss.str();
 }
 
-void BNL_UDP::FlushSocket(int sock){
-  //turn on non-blocking
-  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL)| O_NONBLOCK);
-  int ret;
-  do{
-    ret = recv(sock,buffer,buffer_size,0);      
-  }while(ret != -1);
-  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & (~O_NONBLOCK));
+static uint64_t now_us(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return uint64_t(ts.tv_sec)*1000000 + uint64_t(ts.tv_nsec)/1000;
+}
+
+static int wait_ready(int sock, short events, uint64_t deadline){
+  //Wait in ppoll until the socket has one of events or the deadline (CLOCK_MONOTONIC us) passes.
+  //Returns 0 when ready, or -1 with errno set (ETIMEDOUT on timeout)
+  while(true){
+    uint64_t now = now_us();
+    if(now >= deadline){
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    uint64_t wait = deadline - now;
+    struct timespec ts; ts.tv_sec = wait/1000000; ts.tv_nsec = (wait%1000000)*1000;
+    struct pollfd pfd; pfd.fd = sock; pfd.events = events; pfd.revents = 0;
+    int ret = ppoll(&pfd,1,&ts,NULL);
+    if(ret > 0){
+      return 0;
+    }else if(ret < 0 && errno != EINTR){
+      return -1;
+    }
+  }
+}
+
+static int wait_readable(int sock, uint64_t deadline){
+  return wait_ready(sock,POLLIN,deadline);
+}
+
+static ssize_t send_packet(int sock, void const * data, size_t size, uint64_t deadline){
+  //send() on the non-blocking socket; a full socket buffer (EAGAIN) waits for POLLOUT
+  //and sends again until the deadline.
+  //Returns the size sent, or -1 with errno set (ETIMEDOUT if the buffer never drained)
+  while(true){
+    ssize_t sent_size = send(sock,data,size,0);
+    if(sent_size >= 0){
+      return sent_size;
+    }else if(errno == EINTR){
+      continue;
+    }else if(errno != EAGAIN && errno != EWOULDBLOCK){
+      return -1;
+    }
+    if(wait_ready(sock,POLLOUT,deadline) < 0){
+      return -1;
+    }
+  }
+}
+
+ssize_t BNL_UDP::RecvReply(int sock, uint64_t deadline){
+  //Receive one packet into buffer.
+  //Returns the packet size, or -1 with errno set (ETIMEDOUT on timeout)
+  while(true){
+    if(wait_readable(sock,deadline) < 0){
+      return -1;
+    }
+    ssize_t reply_size = recv(sock,buffer,buffer_size,0);
+    if(reply_size >= 0){
+      stats.packets_received++;
+      stats.bytes_received += reply_size;
+      return reply_size;
+    }else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+      return -1;
+    }
+  }
+}
+
+void BNL_UDP::ResizeArena(MessageArena & arena, size_t count, size_t slot_size){
+  //Only ever grows, so the bulk paths don't allocate once warmed up
+  if((arena.headers.size() >= count) && (arena.slotSize >= slot_size)){
+    return;
+  }
+  count = std::max(count,arena.headers.size());
+  slot_size = std::max(slot_size,arena.slotSize);
+  arena.headers.assign(count,mmsghdr());
+  arena.iovecs.resize(count);
+  arena.data.resize(count*slot_size);
+  arena.slotSize = slot_size;
+  for(size_t iMsg = 0; iMsg < count;iMsg++){
+    arena.iovecs[iMsg].iov_base = &arena.data[iMsg*slot_size];
+    arena.iovecs[iMsg].iov_len  = slot_size;
+    memset(&arena.headers[iMsg],0,sizeof(mmsghdr));
+    arena.headers[iMsg].msg_hdr.msg_iov    = &arena.iovecs[iMsg];
+    arena.headers[iMsg].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+void BNL_UDP::SendBatch(int sock, size_t count, uint64_t deadline){
+  //Send the first count messages of sendArena (iov_len holds each message's size).
+  //A full socket buffer waits for POLLOUT until the deadline
+  size_t sent = 0;
+  while(sent < count){
+    int ret = sendmmsg(sock,&sendArena.headers[sent],count - sent,0);
+    if(ret < 0){
+      if(errno == EINTR){
+	continue;
+      }
+      if((errno == EAGAIN || errno == EWOULDBLOCK) && (wait_ready(sock,POLLOUT,deadline) == 0)){
+	continue;
+      }
+      BUException::SEND_FAILED e;
+      e.Append("BNL_UDP::SendBatch(int,size_t,uint64_t)\n");
+      e.Append("Errnum: ");
+      e.Append(strerror(errno));
+      throw e;
+    }
+    for(int iMsg = 0; iMsg < ret;iMsg++){
+      stats.bytes_sent += sendArena.headers[sent+iMsg].msg_len;
+    }
+    stats.packets_sent += ret;
+    sent += ret;
+  }
+}
+
+int BNL_UDP::RecvBatch(int sock, uint64_t deadline, size_t max_count){
+  //Wait for data, then take up to max_count packets into recvArena with a single recvmmsg.
+  //Returns the number of packets, or -1 with errno set (ETIMEDOUT on timeout)
+  max_count = std::min(max_count,recvArena.headers.size());
+  while(true){
+    if(wait_readable(sock,deadline) < 0){
+      return -1;
+    }
+    int ret = recvmmsg(sock,&recvArena.headers[0],max_count,MSG_DONTWAIT,NULL);
+    if(ret >= 0){
+      stats.packets_received += ret;
+      for(int iMsg = 0; iMsg < ret;iMsg++){
+	stats.bytes_received += recvArena.headers[iMsg].msg_len;
+      }
+      return ret;
+    }else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+      return -1;
+    }
+  }
+}
+
+ssize_t BNL_UDP::RecvMatchingReply(int sock, uint64_t deadline, uint16_t address, size_t word_count){
+  //Receive until a full size reply echoing an address in [address,address+word_count) arrives.
+  //Anything else is a stale reply (from an earlier timed out transaction) and is dropped here,
+  //so no separate flush is needed before sending
+  bool drained = false;
+  while(true){
+    ssize_t reply_size = RecvReply(sock,deadline);
+    if(reply_size < 0){
+      if(drained){
+	stats.stale_drains++;
+      }
+      return reply_size;
+    }
+    if(reply_size < WIB_RPLY_PACKET_SIZE){
+      stats.short_replies++;
+      drained = true;
+      continue;
+    }
+    uint16_t reply_address = WIBReplyAddress(buffer);
+    if((reply_address >= address) && (reply_address < (address + word_count))){
+      if(drained){
+	stats.stale_drains++;
+      }
+      return reply_size;
+    }
+    stats.bad_address++;
+    drained = true;
+  }
+}
+
+void BNL_UDP::CheckRemoteUp(char const * caller){
+  //Fail fast instead of waiting out timeouts on a remote that stopped answering
+  if(!retryPolicy->Allow()){
+    stats.fail_fast++;
+    BUException::BAD_REPLY e;
+    std::stringstream ss;
+    ss << caller << "\n";
+    ss << "Remote " << remoteAddress << ":" << readPort << "/" << writePort 
+       << " is not responding, request not sent\n";
+    e.Append(ss.str().c_str());
+    throw e;
+  }
+}
+
+void BNL_UDP::RecordReceiveFailure(){
+  //Called right after a failed receive, before errno changes
+  if(errno == ETIMEDOUT){
+    stats.timeouts++;
+    lastFailure = FAILURE_TIMEOUT;
+  }else{
+    lastFailure = FAILURE_ERROR;
+  }
+  retryPolicy->RecordTimeout();
+}
+
+void BNL_UDP::RecordRetry(uint64_t count){
+  stats.retries += count;
+  if(lastFailure == FAILURE_TIMEOUT){
+    stats.retry_timeout += count;
+  }else{
+    stats.retry_error += count;
+  }
+}
+
+void BNL_UDP::SetRetryPolicy(BNL_UDP_RetryPolicy * policy){
+  if(policy == NULL || policy == retryPolicy){
+    return;
+  }
+  delete retryPolicy;
+  retryPolicy = policy;
 }
   
 void BNL_UDP::Clear(){
@@ -96,6 +287,8 @@ void BNL_UDP::Clear(){
 void BNL_UDP::Setup(std::string const & address,uint16_t port_offset){
   //Reset the network structures
   Clear();
+  //New remote, forget what we learned about the old one
+  retryPolicy->Reset();
 
   //Allocate the recv buffer
   ResizeBuffer();
@@ -166,10 +359,9 @@ void BNL_UDP::Setup(std::string const & address,uint16_t port_offset){
     e.Append("write socket\n");
     throw e;
   }      
-  //Set a timeout for the recv socket so we don't hang on a reply
-  struct timeval tv; tv.tv_sec=TIMEOUT_SECONDS; tv.tv_usec=TIMEOUT_MICROSECONDS;
-  setsockopt(readSocketFD, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv,sizeof(struct timeval));
-  setsockopt(writeSocketFD, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv,sizeof(struct timeval));
+  //The sockets stay non-blocking, reply timeouts are handled with ppoll deadlines
+  fcntl(readSocketFD, F_SETFL, fcntl(readSocketFD, F_GETFL) | O_NONBLOCK);
+  fcntl(writeSocketFD, F_SETFL, fcntl(writeSocketFD, F_GETFL) | O_NONBLOCK);
 
   //connect the read socket
   readAddr = *((struct sockaddr_in *) res->ai_addr);
@@ -192,47 +384,45 @@ void BNL_UDP::Setup(std::string const & address,uint16_t port_offset){
 
   //Allocate the receive buffer to default size
   ResizeBuffer();
+  //Preallocate the sendmmsg/recvmmsg arenas for the default window
+  ResizeArena(sendArena,readWindow,WIB_MAX_UDP_PAYLOAD);
+  ResizeArena(recvArena,readWindow,WIB_RPLY_ARENA_SLOT_SIZE);
 }
 
 void BNL_UDP::WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count){
-  while(retry_count > 1){
+  CheckRemoteUp("BNL_UDP::WriteWithRetry(uint16_t,uint32_t)");
+  for(uint8_t attempt = 0; ; attempt++){
     try{
       //Do the write
-      Write(address,value);
-      usleep(10);
+      WriteAttempt(address,value,attempt);
       //if everything goes well, return
       return;
     }catch(BUException::BAD_REPLY &e){
-      //eat the exception
+      //Out of attempts (or the policy says stop), let the exception fall down the stack
+      if((attempt+1 >= retry_count) || !retryPolicy->AllowRetry(attempt+1)){
+	throw;
+      }
     }
-    total_retry_count++;
-    retry_count--;
-    usleep(10);
+    RecordRetry();
+    usleep(retryPolicy->Backoff(attempt+1));
   }
-  //Last chance we don't catch the exception and let it fall down the stack
-  //Do the write
-  Write(address,value);
-  usleep(10);
 }
 void BNL_UDP::Write(uint16_t address, uint32_t value){
-
-  //Flush this socket
-  FlushSocket(writeSocketFD);
+  CheckRemoteUp("BNL_UDP::Write(uint16_t,uint32_t)");
+  WriteAttempt(address,value,0);
+}
+void BNL_UDP::WriteAttempt(uint16_t address, uint32_t value, uint8_t attempt){
 
   //Build the packet to send
-  //build the send packet
-  WIB_packet_t packet;
-  packet.key = htonl(WIB_PACKET_KEY);
-  packet.reg_addr = htons(address);
-  packet.data_MSW = htons(uint16_t((value >> 16) & 0xFFFF));
-  packet.data_LSW = htons(uint16_t((value >>  0) & 0xFFFF));
-  packet.trailer = htons(WIB_REQUEST_PACKET_TRAILER);
+  uint8_t packet[WIB_REQUEST_PACKET_SIZE];
+  BuildWIBRequest(packet,address,value);
 
   //send the packet
   ssize_t send_size = sizeof(packet);
   ssize_t sent_size = 0;
-  if( send_size != (sent_size = send(writeSocketFD,
-				     &packet,send_size,0))){
+  uint64_t sendTime = now_us();
+  if( send_size != (sent_size = send_packet(writeSocketFD,packet,send_size,
+					    sendTime+retryPolicy->Timeout(attempt)))){
     //bad send
     BUException::SEND_FAILED e;
     if(sent_size == -1){
@@ -242,168 +432,254 @@ void BNL_UDP::Write(uint16_t address, uint32_t value){
     } 
     throw e;
   }
+  stats.packets_sent++;
+  stats.bytes_sent += sent_size;
 
   //If configured, capture confirmation packet
   if(writeAck ){
-    ssize_t reply_size = recv(writeSocketFD,
-			      buffer,buffer_size,0);
-
+    ssize_t reply_size = RecvMatchingReply(writeSocketFD,sendTime+retryPolicy->Timeout(attempt),address,1);
     if(-1 == reply_size){
+      RecordReceiveFailure();
       BUException::BAD_REPLY e;
       std::stringstream ss;
       e.Append("BNL_UDP::Write(uint16_t,uint32_t)\n");
       ss << "Errnum(" << errno << "): " << strerror(errno) << "\n";
       e.Append(ss.str().c_str());
-      e.Append(dump_packet((uint8_t*) &packet,send_size).c_str());
-      throw e;
-    }else if( reply_size < WIB_RPLY_PACKET_SIZE){
-      BUException::BAD_REPLY e;
-      std::stringstream ss;
-      ss << "Bad Size: " << reply_size << "\n";
-      e.Append("BNL_UDP::Write(uint16_t,uint32_t)\n");
-      e.Append(ss.str().c_str());
-      e.Append(dump_packet(buffer,reply_size).c_str());
+      e.Append(dump_packet(packet,send_size).c_str());
       throw e;
     }
-    uint16_t reply_address =  uint16_t(buffer[0] << 8 | buffer[1]);
-    if( reply_address != address){
-      BUException::BAD_REPLY e;
-      std::stringstream ss;
-      ss << "Bad address: " << uint32_t(address) << " != " << uint32_t(reply_address) << "\n";
-      e.Append("BNL_UDP::Write(uint16_t,uint32_t)\n");
-      e.Append(ss.str().c_str());
-      e.Append(dump_packet(buffer,reply_size).c_str());
-      throw e;    
-    }    
+    uint64_t latency = now_us() - sendTime;
+    stats.write_latency.Record(latency);
+    //Only first attempts give an unambiguous RTT sample
+    retryPolicy->RecordSuccess((attempt == 0) ? std::max(latency,uint64_t(1)) : 0);
   }  
 }
-void BNL_UDP::Write(uint16_t address, std::vector<uint32_t> const & values){
-  Write(address,values.data(),values.size());
+void BNL_UDP::TableLoaded(AddressTable & table){
+  //The probe writes registers that only have read-only fields, so the firmware ignores the data
+  boost::unordered_map<uint16_t,bool> readOnly;
+  std::vector<std::string> names = table.GetNames();
+  for(size_t iName = 0; iName < names.size();iName++){
+    Item const * item = table.GetItem(names[iName]);
+    bool itemReadOnly = (item->mode == Item::READ);
+    boost::unordered_map<uint16_t,bool>::iterator it = readOnly.find(item->address);
+    if(it == readOnly.end()){
+      readOnly[item->address] = itemReadOnly;
+    }else{
+      it->second = it->second && itemReadOnly;
+    }
+  }
+  probeAddress = -1;
+  for(boost::unordered_map<uint16_t,bool>::const_iterator it = readOnly.begin(); it != readOnly.end();it++){
+    if(!it->second || (probeAddress >= 0 && it->first >= probeAddress)){
+      continue;
+    }
+    boost::unordered_map<uint16_t,bool>::const_iterator itNext = readOnly.find(uint16_t(it->first+1));
+    if(itNext != readOnly.end() && itNext->second){
+      probeAddress = it->first;
+    }
+  }
+}
+
+void BNL_UDP::ProbeBlockWrite(){
+  if(!writeAck || (probeAddress < 0)){
+    //Nothing safe to probe with (or nothing to learn without acks), assume the firmware takes them
+    blockWrite = BLOCK_WRITE_ON;
+    return;
+  }
+  //A single write first: throws if the remote isn't answering at all (the probe runs again next
+  //time) and gives the retry policy an RTT sample for the block's timeout
+  uint16_t address = uint16_t(probeAddress);
+  WriteWithRetry(address,0);
+  uint32_t values[2] = {0,0};
+  for(int iTry = 0; iTry < WIB_BLOCK_WRITE_PROBE_TRIES;iTry++){
+    try{
+      WriteBlock(address,values,2);
+      blockWrite = BLOCK_WRITE_ON;
+      return;
+    }catch(BUException::BAD_REPLY &e){
+    }
+  }
+  //Single writes are answered, blocks aren't
+  blockWrite = BLOCK_WRITE_OFF;
 }
+
 void BNL_UDP::Write(uint16_t address, uint32_t const * values, size_t word_count){
+  CheckRemoteUp("BNL_UDP::Write(uint16_t,uint32_t*,size_t)");
+  if((blockWrite == BLOCK_WRITE_PROBE) && (word_count > 1)){
+    ProbeBlockWrite();
+  }
+  if((blockWrite == BLOCK_WRITE_ON) && (word_count > 1)){
+    //Send the block as MTU sized datagrams, iWord is how much was acknowledged
+    size_t iWord = 0;
+    if(batchSyscalls){
+      iWord = WriteBlocksBatched(address,values,word_count);
+    }else{
+      try{
+	while(iWord < word_count){
+	  size_t block_count = std::min(word_count - iWord,size_t(WIB_MAX_BLOCK_WRITE_WORDS));
+	  WriteBlock(uint16_t(address+iWord),values+iWord,block_count);
+	  iWord += block_count;
+	}
+      }catch(BUException::BAD_REPLY &e){
+      }
+    }
+    if(iWord == word_count){
+      return;
+    }
+    //A datagram without an ack may or may not have been written, and writing its words again
+    //would repeat any action bits in it. Leave it to the caller.
+    stats.block_write_failures++;
+    BUException::BAD_REPLY e;
+    char info[160];
+    snprintf(info,sizeof(info),
+	     "BNL_UDP::Write(uint16_t,uint32_t*,size_t)\nBlock write to %s: words 0x%04X-0x%04X not acknowledged, "
+	     "they may not have been written\n",
+	     remoteAddress.c_str(),unsigned(uint16_t(address+iWord)),unsigned(uint16_t(address+word_count-1)));
+    e.Append(info);
+    throw e;
+  }
+
+  if(word_count > 1){
+    stats.per_word_writes++;
+  }
   for(size_t iWrite = 0; iWrite < word_count;iWrite++){
     WriteWithRetry(address,values[iWrite]);
     address++;
   }
+}
+
+size_t BNL_UDP::WriteBlocksBatched(uint16_t address, uint32_t const * values, size_t word_count){
+  //Send every datagram of the block with one sendmmsg and collect the acks with recvmmsg.
+  //Returns the number of leading words whose datagrams were acknowledged
+  size_t packetCount = (word_count + WIB_MAX_BLOCK_WRITE_WORDS - 1)/WIB_MAX_BLOCK_WRITE_WORDS;
+  ResizeArena(sendArena,packetCount,WIB_MAX_UDP_PAYLOAD);
+  for(size_t iPacket = 0; iPacket < packetCount;iPacket++){
+    size_t iWord = iPacket*WIB_MAX_BLOCK_WRITE_WORDS;
+    size_t block_count = std::min(word_count - iWord,size_t(WIB_MAX_BLOCK_WRITE_WORDS));
+    sendArena.iovecs[iPacket].iov_len = BuildWIBRequest((uint8_t*) sendArena.iovecs[iPacket].iov_base,
+							uint16_t(address+iWord),values+iWord,block_count);
+  }
+  uint64_t sendTime = now_us();
+  SendBatch(writeSocketFD,packetCount,sendTime+retryPolicy->Timeout(0));
+  if(!writeAck){
+    return word_count;
+  }
 
-////////  //Flush the socket
-////////  FlushSocket(writeSocketFD);
-////////
-////////  //Compute the size of this multi-write packet
-////////  // values.size() - 1 gets the number of address and MSW/LSW groups that aren't already in the packet
-////////  size_t packetSize = sizeof(WIB_packet_t) + (word_count-1)*6; 
-////////  //resize the buffer if needed  
-////////  ResizeBuffer(packetSize);
-////////  
-////////  //Set the packet key
-////////  (*((uint32_t*) buffer)) = htonl(WIB_PACKET_KEY);
-////////  //Create a pointer to 16bit words that points to the parts of buffer that are after the first 32bit word (WIB key)
-////////  uint16_t * packet = (uint16_t*) (buffer + sizeof(uint32_t));
-////////  for(size_t iWord = 0; iWord < word_count;iWord++){
-////////    //Set the word address
-////////    packet[0] = htons(address);
-////////    //Set the MS 16bit part of the 32bit word
-////////    packet[1] = htons(uint16_t((values[iWord] >> 16) & 0xFFFF));
-////////    //Set the LS 16bit part of the 32bit word
-////////    packet[2] = htons(uint16_t((values[iWord] >>  0) & 0xFFFF));
-////////    //move the write address forward 1 word
-////////    address++;
-////////    //move the packet pointer forward to the next word block
-////////    packet+=3;
-////////  }
-////////  //Set the packet trailer
-////////  (*packet) = htons(WIB_REQUEST_PACKET_TRAILER);
-////////
-////////  //send the packet
-////////  ssize_t send_size = packetSize;
-////////  ssize_t sent_size = 0;
-////////  if( send_size != (sent_size = send(writeSocketFD,
-////////				     buffer,send_size,0))){
-////////    //bad send
-////////    BUException::SEND_FAILED e;
-////////    if(sent_size == -1){
-////////      e.Append("BNL_UDP::Write(uint16_t,uint32_t*,size_t)\n");
-////////      e.Append("Errnum: ");
-////////      e.Append(strerror(errno));
-////////    } 
-////////    throw e;
-////////  }
-////////  //If configured, capture confirmation packet
-////////  if(writeAck ){
-////////    ssize_t reply_size = recv(writeSocketFD,
-////////			      buffer,buffer_size,0);
-////////
-////////
-////////    //    writeAddr = readAddr;
-////////    //    writeAddr.sin_port = htons(replyPort);
-////////
-////////    //    sockaddr_len = sizeof(writeAddr);
-////////    //    ssize_t reply_size = recvfrom(recvSocketFD,
-//////////    recvfrom(recvSocketFD,
-//////////	     buffer,buffer_size,0,
-//////////	     (struct sockaddr*)&writeAddr,&sockaddr_len);    
-////////    if(-1 == reply_size){
-////////      BUException::BAD_REPLY e;
-////////      e.Append("BNL_UDP::Write(uint16_t,uint32_t*,size_t)\n");
-////////      e.Append(strerror(errno));
-////////      throw e;
-////////    }else if( reply_size < WIB_RPLY_PACKET_SIZE){
-////////      BUException::BAD_REPLY e;
-////////      std::stringstream ss;
-////////      ss << "Bad Size: " << reply_size << "\n";
-////////      e.Append("BNL_UDP::Write(uint16_t,uint32_t*,size_t)\n");
-////////      e.Append(ss.str().c_str());
-////////      e.Append(dump_packet(buffer,reply_size).c_str());
-////////      throw e;
-////////    }
-//////////    uint16_t reply_address =  uint16_t(buffer[0] << 8 | buffer[1]);
-//////////    if( reply_address != address){
-//////////      BUException::BAD_REPLY e;
-//////////      std::stringstream ss;
-//////////      ss << "Bad address: " << address << " != " << reply_address << "\n";
-//////////      e.Append(ss.str().c_str());
-//////////      throw e;    
-//////////    }    
-////////  }  
+  //Match acks to datagrams by the echoed address, dropping stale replies
+  std::vector<bool> acked(packetCount,false);
+  size_t ackCount = 0;
+  uint64_t deadline = sendTime+retryPolicy->Timeout(0);
+  bool drained = false;
+  while(ackCount < packetCount){
+    int nReplies = RecvBatch(writeSocketFD,deadline,packetCount - ackCount);
+    if(nReplies < 0){
+      RecordReceiveFailure();
+      break;
+    }
+    for(int iReply = 0; iReply < nReplies;iReply++){
+      uint8_t const * reply = (uint8_t const *) recvArena.iovecs[iReply].iov_base;
+      if(recvArena.headers[iReply].msg_len < WIB_RPLY_PACKET_SIZE){
+	stats.short_replies++;
+	drained = true;
+	continue;
+      }
+      uint16_t reply_address = WIBReplyAddress(reply);
+      if((reply_address < address) || (reply_address >= (address + word_count))){
+	stats.bad_address++;
+	drained = true;
+	continue;
+      }
+      stats.write_latency.Record(now_us() - sendTime);
+      retryPolicy->RecordSuccess(0);
+      size_t iPacket = (reply_address - address)/WIB_MAX_BLOCK_WRITE_WORDS;
+      if(!acked[iPacket]){
+	acked[iPacket] = true;
+	ackCount++;
+      }
+    }
+  }
+  if(drained){
+    stats.stale_drains++;
+  }
+  size_t iPacket = 0;
+  while((iPacket < packetCount) && acked[iPacket]){
+    iPacket++;
+  }
+  return std::min(iPacket*WIB_MAX_BLOCK_WRITE_WORDS,word_count);
+}
+
+void BNL_UDP::WriteBlock(uint16_t address, uint32_t const * values, size_t word_count){
+  //resize the buffer if needed  
+  ResizeBuffer(WIB_REQUEST_PACKET_SIZE + (word_count-1)*WIB_REQUEST_WORD_SIZE);
+  size_t packetSize = BuildWIBRequest(buffer,address,values,word_count);
+
+  //send the packet
+  ssize_t send_size = packetSize;
+  ssize_t sent_size = 0;
+  uint64_t sendTime = now_us();
+  if( send_size != (sent_size = send_packet(writeSocketFD,buffer,send_size,
+					    sendTime+retryPolicy->Timeout(0)))){
+    //bad send
+    BUException::SEND_FAILED e;
+    if(sent_size == -1){
+      e.Append("BNL_UDP::WriteBlock(uint16_t,uint32_t*,size_t)\n");
+      e.Append("Errnum: ");
+      e.Append(strerror(errno));
+    } 
+    throw e;
+  }
+  stats.packets_sent++;
+  stats.bytes_sent += sent_size;
+
+  //If configured, capture confirmation packet (one per datagram)
+  if(writeAck ){
+    //The ack echoes an address from the block
+    ssize_t reply_size = RecvMatchingReply(writeSocketFD,sendTime+retryPolicy->Timeout(0),address,word_count);
+    if(-1 == reply_size){
+      RecordReceiveFailure();
+      BUException::BAD_REPLY e;
+      std::stringstream ss;
+      e.Append("BNL_UDP::WriteBlock(uint16_t,uint32_t*,size_t)\n");
+      ss << "Errnum(" << errno << "): " << strerror(errno) << "\n";
+      e.Append(ss.str().c_str());
+      throw e;
+    }
+    stats.write_latency.Record(now_us() - sendTime);
+    retryPolicy->RecordSuccess(0);
+  }  
 }
 
 uint32_t BNL_UDP::ReadWithRetry(uint16_t address,uint8_t retry_count){
-  uint32_t val;
-  while(retry_count > 1){
+  CheckRemoteUp("BNL_UDP::ReadWithRetry(uint16_t)");
+  for(uint8_t attempt = 0; ; attempt++){
     try{
-      //Do the write
-      val = Read(address);
-      usleep(10);
-      //if everything goes well, return
-      return val;
+      //Do the read, if everything goes well, return
+      return ReadAttempt(address,attempt);
     }catch(BUException::BAD_REPLY &e){
-      //eat the exception
+      //Out of attempts (or the policy says stop), let the exception fall down the stack
+      if((attempt+1 >= retry_count) || !retryPolicy->AllowRetry(attempt+1)){
+	throw;
+      }
     }
-    usleep(10);
-    total_retry_count++;
-    retry_count--;
+    RecordRetry();
+    usleep(retryPolicy->Backoff(attempt+1));
   }
-  //Last chance we don't catch the exception and let it fall down the stack
-  val = Read(address);  
-  usleep(10);
-  return val;
 }
 uint32_t BNL_UDP::Read(uint16_t address){
-  //Flush the socket
-  FlushSocket(readSocketFD);
-
+  CheckRemoteUp("BNL_UDP::Read(uint16_t)");
+  return ReadAttempt(address,0);
+}
+uint32_t BNL_UDP::ReadAttempt(uint16_t address, uint8_t attempt){
   //build the send packet
-  WIB_packet_t packet;
-  packet.key = htonl(WIB_PACKET_KEY);
-  packet.reg_addr = htons(address);
-  packet.data_MSW = packet.data_LSW = 0;
-  packet.trailer = htons(WIB_REQUEST_PACKET_TRAILER);
+  uint8_t packet[WIB_REQUEST_PACKET_SIZE];
+  BuildWIBRequest(packet,address);
 
   //send the packet
   ssize_t send_size = sizeof(packet);
   ssize_t sent_size = 0;
-  if( send_size != (sent_size = send(readSocketFD,
-				     &packet,send_size,0))){
+  uint64_t sendTime = now_us();
+  if( send_size != (sent_size = send_packet(readSocketFD,packet,send_size,
+					    sendTime+retryPolicy->Timeout(attempt)))){
     //bad send
     BUException::SEND_FAILED e;
     if(sent_size == -1){
@@ -413,51 +689,201 @@ uint32_t BNL_UDP::Read(uint16_t address){
     } 
     throw e;
   }
+  stats.packets_sent++;
+  stats.bytes_sent += sent_size;
 
-  //Get the reply packet with the register data in it.   
-  ssize_t reply_size = recv(readSocketFD,
-			    buffer,buffer_size,0);
-			    
+  //Get the reply packet with the register data in it (stale replies are dropped)
+  ssize_t reply_size = RecvMatchingReply(readSocketFD,sendTime+retryPolicy->Timeout(attempt),address,1);
   if(ssize_t(-1) == reply_size){
+    RecordReceiveFailure();
     BUException::BAD_REPLY e;
     std::stringstream ss;
     e.Append("BNL_UDP::Read(uint16_t)\n");
     ss << "Errnum(" << errno << "): " << strerror(errno) << "\n";
     e.Append(ss.str().c_str());
-    e.Append(dump_packet((uint8_t *)&packet,send_size).c_str());
+    e.Append(dump_packet(packet,send_size).c_str());
     throw e;
-  }else if( reply_size < WIB_RPLY_PACKET_SIZE){
-    BUException::BAD_REPLY e;
-    std::stringstream ss;
-    ss << "Bad Size: " << reply_size << "\n";
-    e.Append("BNL_UDP::Read(uint16_t)\n");
-    e.Append(ss.str().c_str());
-    e.Append(dump_packet(buffer,reply_size).c_str());
+  }
+  uint64_t latency = now_us() - sendTime;
+  stats.read_latency.Record(latency);
+  //Only first attempts give an unambiguous RTT sample
+  retryPolicy->RecordSuccess((attempt == 0) ? std::max(latency,uint64_t(1)) : 0);
+
+  uint32_t ret = WIBReplyValue(buffer);
+  return ret;
+}
+
+void BNL_UDP::SendReadRequest(uint16_t address, uint64_t deadline){
+  //build the send packet
+  uint8_t packet[WIB_REQUEST_PACKET_SIZE];
+  BuildWIBRequest(packet,address);
+
+  //send the packet
+  ssize_t send_size = sizeof(packet);
+  ssize_t sent_size = 0;
+  if( send_size != (sent_size = send_packet(readSocketFD,packet,send_size,deadline))){
+    //bad send
+    BUException::SEND_FAILED e;
+    if(sent_size == -1){
+      e.Append("BNL_UDP::SendReadRequest(uint16_t)\n");
+      e.Append("Errnum: ");
+      e.Append(strerror(errno));
+    } 
     throw e;
   }
-  uint16_t reply_address =  uint16_t(buffer[0] << 8 | buffer[1]);
-  if( reply_address != address){
+  stats.packets_sent++;
+  stats.bytes_sent += sent_size;
+}
+
+size_t BNL_UDP::ReadPipelined(std::vector<uint16_t> const & addresses,
+			      std::vector<uint32_t> & values,
+			      std::vector<bool> & done,
+			      uint8_t attempt){
+  //One pass over every address not yet marked done.
+  //Up to readWindow requests are kept in flight and each reply is matched to the
+  //oldest outstanding request for the address it echoes.
+  //With batchSyscalls the window is topped up with one sendmmsg and all pending
+  //replies are taken with one recvmmsg.
+  //attempt selects the reply timeout from the retry policy.
+  //Returns the number of addresses that did not get a reply in this pass.
+  //Stale replies from earlier passes are dropped as they are received.
+
+  if(batchSyscalls){
+    ResizeArena(sendArena,readWindow,WIB_REQUEST_PACKET_SIZE);
+    ResizeArena(recvArena,readWindow,WIB_RPLY_ARENA_SLOT_SIZE);
+  }
+
+  //address -> indices (in send order) of requests waiting for a reply
+  boost::unordered_map<uint16_t,std::deque<size_t> > inFlight;
+  size_t inFlightCount = 0;
+  size_t lost = 0;
+  size_t iNext = 0;
+  uint32_t timeout = retryPolicy->Timeout(attempt);
+  //send time of each request for the latency histogram
+  std::vector<uint64_t> sentAt(addresses.size(),0);
+  bool drained = false;
+  
+  while((iNext < addresses.size()) || (inFlightCount > 0)){
+    //Top up the window
+    size_t queued = 0;
+    uint64_t sendTime = now_us();
+    while((inFlightCount < readWindow) && (iNext < addresses.size())){
+      if(!done[iNext]){
+	if(batchSyscalls){
+	  sendArena.iovecs[queued].iov_len = BuildWIBRequest((uint8_t*) sendArena.iovecs[queued].iov_base,addresses[iNext]);
+	  queued++;
+	}else{
+	  SendReadRequest(addresses[iNext],sendTime+timeout);
+	}
+	inFlight[addresses[iNext]].push_back(iNext);
+	sentAt[iNext] = sendTime;
+	inFlightCount++;
+      }
+      iNext++;
+    }
+    if(queued){
+      SendBatch(readSocketFD,queued,sendTime+timeout);
+    }
+    if(inFlightCount == 0){
+      break;
+    }
+
+    //Get the reply packets with the register data in them.   
+    int nReplies = 1;
+    ssize_t reply_size = 0;
+    if(batchSyscalls){
+      nReplies = RecvBatch(readSocketFD,now_us()+timeout,inFlightCount);
+    }else{
+      reply_size = RecvReply(readSocketFD,now_us()+timeout);
+      if(ssize_t(-1) == reply_size){
+	nReplies = -1;
+      }
+    }
+    if(nReplies < 0){
+      //Timeout: everything in flight is lost for this pass
+      RecordReceiveFailure();
+      lost += inFlightCount;
+      inFlight.clear();
+      inFlightCount = 0;
+      continue;
+    }
+
+    for(int iReply = 0; iReply < nReplies;iReply++){
+      uint8_t const * reply = buffer;
+      if(batchSyscalls){
+	reply = (uint8_t const *) recvArena.iovecs[iReply].iov_base;
+	reply_size = recvArena.headers[iReply].msg_len;
+      }
+      if( reply_size < WIB_RPLY_PACKET_SIZE){
+	//Runt packet, we can't tell who it was for
+	stats.short_replies++;
+	drained = true;
+	continue;
+      }
+      uint16_t reply_address = WIBReplyAddress(reply);
+      boost::unordered_map<uint16_t,std::deque<size_t> >::iterator itRequest = inFlight.find(reply_address);
+      if((itRequest == inFlight.end()) || itRequest->second.empty()){
+	//Stale reply for something we aren't waiting on
+	stats.bad_address++;
+	drained = true;
+	continue;
+      }
+      retryPolicy->RecordSuccess(0);
+      size_t index = itRequest->second.front();
+      stats.read_latency.Record(now_us() - sentAt[index]);
+      itRequest->second.pop_front();
+      inFlightCount--;
+      values[index] = WIBReplyValue(reply);
+      done[index] = true;
+    }
+  }
+  if(drained){
+    stats.stale_drains++;
+  }
+  return lost;
+}
+
+std::vector<uint32_t> BNL_UDP::Read(std::vector<uint16_t> const & addresses){
+  CheckRemoteUp("BNL_UDP::Read(std::vector<uint16_t>)");
+  std::vector<uint32_t> values(addresses.size(),0);
+  std::vector<bool> done(addresses.size(),false);
+  size_t lost = ReadPipelined(addresses,values,done,0);
+  if(lost){
     BUException::BAD_REPLY e;
     std::stringstream ss;
-    ss << "Bad address: " << uint32_t(address) << " != " << uint32_t(reply_address) << "\n";
-    e.Append("BNL_UDP::Read(uint16_t)\n");
+    ss << "Missing " << lost << " of " << addresses.size() << " replies\n";
+    e.Append("BNL_UDP::Read(std::vector<uint16_t>)\n");
     e.Append(ss.str().c_str());
-    e.Append(dump_packet(buffer,reply_size).c_str());
-    throw e;    
+    throw e;
   }
-  
+  return values;
+}
 
-    //  }
-  uint32_t ret = ( (uint32_t(buffer[2]) << 24) | 
-		   (uint32_t(buffer[3]) << 16) | 
-		   (uint32_t(buffer[4]) <<  8) | 
-		   (uint32_t(buffer[5]) <<  0));
-  return ret;
+std::vector<uint32_t> BNL_UDP::ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count){
+  CheckRemoteUp("BNL_UDP::ReadWithRetry(std::vector<uint16_t>)");
+  std::vector<uint32_t> values(addresses.size(),0);
+  std::vector<bool> done(addresses.size(),false);
+  size_t lost = 0;
+  for(uint8_t attempt = 0; (lost = ReadPipelined(addresses,values,done,attempt)) != 0; attempt++){
+    //Only the lost reads are sent again on the next pass
+    if((attempt+1 >= retry_count) || !retryPolicy->AllowRetry(attempt+1)){
+      BUException::BAD_REPLY e;
+      std::stringstream ss;
+      ss << "Missing " << lost << " of " << addresses.size() << " replies after retries\n";
+      e.Append("BNL_UDP::ReadWithRetry(std::vector<uint16_t>)\n");
+      e.Append(ss.str().c_str());
+      throw e;
+    }
+    RecordRetry(lost);
+    usleep(retryPolicy->Backoff(attempt+1));
+  }
+  return values;
 }
 
 
 BNL_UDP::~BNL_UDP(){
   Clear();
+  delete retryPolicy;
 }
 
 
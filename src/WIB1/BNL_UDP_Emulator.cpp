@@ -0,0 +1,169 @@
+#include "wibmod/WIB1/BNL_UDP_Emulator.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+#include "wibmod/WIB1/BNL_UDP_Protocol.hh"
+#include "wibmod/WIB1/RegisterModel.hh"
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <string.h> //memset, strerror
+#include <errno.h>
+#include <algorithm>
+
+#define EMULATOR_MAX_PACKET 2048
+
+static uint64_t now_us(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return uint64_t(ts.tv_sec)*1000000 + uint64_t(ts.tv_nsec)/1000;
+}
+
+static int bind_udp(std::string const & address, uint16_t port){
+  struct addrinfo * res;
+  if(getaddrinfo(address.c_str(),NULL,NULL,&res)){
+    BUException::BAD_REMOTE_IP e;
+    e.Append("Addr: ");
+    e.Append(address.c_str());
+    e.Append(" could not be resolved.\n");
+    throw e;
+  }
+  struct sockaddr_in addr = *((struct sockaddr_in *) res->ai_addr);
+  freeaddrinfo(res);
+  addr.sin_port = htons(port);
+
+  int sock = socket(AF_INET,SOCK_DGRAM,0);
+  if(sock < 0){
+    BUException::BAD_SOCKET e;
+    e.Append("emulator socket\n");
+    throw e;
+  }
+  if(bind(sock,(struct sockaddr *) &addr,sizeof(addr)) < 0){
+    close(sock);
+    BUException::CONNECTION_FAILED e;
+    char portString[] = "65535\n";
+    snprintf(portString,sizeof(portString),"%u\n",port);
+    e.Append("emulator bind to port ");
+    e.Append(portString);
+    e.Append(strerror(errno));
+    throw e;
+  }
+  return sock;
+}
+
+BNL_UDP_Emulator::BNL_UDP_Emulator(RegisterModel & _model, uint16_t port_offset, std::string const & address):
+  model(_model),portOffset(port_offset),readSocketFD(-1),writeSocketFD(-1),
+  latency(0),jitter(0),dropRate(0),blockWrite(true),rng(port_offset),
+  running(false),requestCount(0),dropCount(0){
+  writeSocketFD = bind_udp(address,WIB_WR_BASE_PORT + port_offset);
+  try{
+    readSocketFD = bind_udp(address,WIB_RD_BASE_PORT + port_offset);
+  }catch(BUException::exBase & e){
+    close(writeSocketFD);
+    throw;
+  }
+}
+
+BNL_UDP_Emulator::~BNL_UDP_Emulator(){
+  Stop();
+  close(readSocketFD);
+  close(writeSocketFD);
+}
+
+void BNL_UDP_Emulator::Start(){
+  if(running){
+    return;
+  }
+  running = true;
+  thread = std::thread(&BNL_UDP_Emulator::Run,this);
+}
+
+void BNL_UDP_Emulator::Stop(){
+  running = false;
+  if(thread.joinable()){
+    thread.join();
+  }
+}
+
+void BNL_UDP_Emulator::Run(){
+  uint8_t buffer[EMULATOR_MAX_PACKET];
+  struct pollfd pfds[2];
+  pfds[0].fd = writeSocketFD; pfds[0].events = POLLIN;
+  pfds[1].fd = readSocketFD;  pfds[1].events = POLLIN;
+  while(running){
+    //Wake up for the next delayed reply, or every 100ms to check for Stop()
+    uint64_t now = now_us();
+    SendDue(now);
+    int timeout_ms = 100;
+    if(!pending.empty()){
+      uint64_t wait = (pending.top().due > now) ? pending.top().due - now : 0;
+      timeout_ms = std::min(uint64_t(timeout_ms),(wait + 999)/1000);
+    }
+    pfds[0].revents = pfds[1].revents = 0;
+    if(poll(pfds,2,timeout_ms) <= 0){
+      continue;
+    }
+    for(int iSock = 0; iSock < 2;iSock++){
+      if(!(pfds[iSock].revents & POLLIN)){
+	continue;
+      }
+      //Take everything that is queued on this socket
+      while(true){
+	struct sockaddr_in from;
+	socklen_t fromLength = sizeof(from);
+	ssize_t size = recvfrom(pfds[iSock].fd,buffer,sizeof(buffer),MSG_DONTWAIT,
+				(struct sockaddr *) &from,&fromLength);
+	if(size < 0){
+	  break;
+	}
+	Handle(pfds[iSock].fd,(iSock == 0),buffer,size,from);
+      }
+    }
+  }
+}
+
+void BNL_UDP_Emulator::Handle(int sock, bool writePort, uint8_t const * data, size_t size,
+			      struct sockaddr_in const & from){
+  size_t wordCount = WIBRequestWordCount(data,size);
+  if(wordCount == 0){
+    return;
+  }
+  requestCount++;
+  if(writePort && wordCount > 1 && !blockWrite){
+    return;
+  }
+  if(dropRate > 0 && std::uniform_real_distribution<double>(0,1)(rng) < dropRate){
+    dropCount++;
+    return;
+  }
+
+  uint16_t firstAddress = WIBRequestAddress(data,0);
+  if(writePort){
+    for(size_t iWord = 0; iWord < wordCount;iWord++){
+      model.Write(WIBRequestAddress(data,iWord),WIBRequestValue(data,iWord));
+    }
+  }
+  //Reply (read data or write ack) echoes the first address
+  PendingReply reply;
+  memset(&reply,0,sizeof(reply));
+  BuildWIBReply(reply.data,firstAddress,model.Read(firstAddress));
+  reply.sock = sock;
+  reply.to = from;
+  reply.due = now_us() + latency;
+  if(jitter){
+    reply.due += std::uniform_int_distribution<uint32_t>(0,jitter)(rng);
+  }
+  pending.push(reply);
+  SendDue(now_us());
+}
+
+void BNL_UDP_Emulator::SendDue(uint64_t now){
+  while(!pending.empty() && pending.top().due <= now){
+    PendingReply const & reply = pending.top();
+    sendto(reply.sock,reply.data,WIB_RPLY_PACKET_SIZE,0,
+	   (struct sockaddr const *) &reply.to,sizeof(reply.to));
+    pending.pop();
+  }
+}
@@ -0,0 +1,504 @@
+#include "wibmod/WIB1/BNL_UDP_Reactor.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+#include "wibmod/WIB1/BNL_UDP_Protocol.hh"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define REACTOR_READ_CHANNEL 0
+#define REACTOR_WRITE_CHANNEL 1
+#define REACTOR_MAX_EVENTS 64
+//epoll user data for the wake-up eventfd (sessions use session*2 + channel)
+#define REACTOR_WAKE_TAG UINT64_MAX
+//Longest sleep when nothing is in flight, so Stop is noticed
+#define REACTOR_IDLE_MS 100
+
+static uint64_t now_us(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return uint64_t(ts.tv_sec)*1000000 + uint64_t(ts.tv_nsec)/1000;
+}
+
+//Completions are the caller's code: one that throws must not take down the reactor thread
+//(and with it every session)
+static void complete(BNL_UDP_Reactor::Completion const & done, bool success, uint32_t value){
+  try{
+    done(success,value);
+  }catch(std::exception & e){
+    fprintf(stderr,"BNL_UDP_Reactor: completion threw: %s\n",e.what());
+  }catch(...){
+    fprintf(stderr,"BNL_UDP_Reactor: completion threw\n");
+  }
+}
+
+static int open_channel(struct sockaddr_in addr, uint16_t port){
+  int sock = socket(AF_INET,SOCK_DGRAM,0);
+  if(sock < 0){
+    BUException::BAD_SOCKET e;
+    e.Append("reactor socket\n");
+    throw e;
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+  addr.sin_port = htons(port);
+  if(connect(sock,(struct sockaddr *) &addr,sizeof(addr)) < 0){
+    close(sock);
+    BUException::CONNECTION_FAILED e;
+    e.Append("reactor socket connect\n");
+    e.Append(strerror(errno));
+    throw e;
+  }
+  return sock;
+}
+
+BNL_UDP_Reactor::BNL_UDP_Reactor():epollFD(-1),wakeFD(-1),running(true){
+  epollFD = epoll_create1(EPOLL_CLOEXEC);
+  wakeFD = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+  if(epollFD < 0 || wakeFD < 0){
+    if(epollFD >= 0){close(epollFD);}
+    if(wakeFD >= 0){close(wakeFD);}
+    BUException::BAD_SOCKET e;
+    e.Append("reactor epoll/eventfd\n");
+    e.Append(strerror(errno));
+    throw e;
+  }
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = REACTOR_WAKE_TAG;
+  epoll_ctl(epollFD,EPOLL_CTL_ADD,wakeFD,&event);
+  thread = std::thread(&BNL_UDP_Reactor::Run,this);
+}
+
+BNL_UDP_Reactor::~BNL_UDP_Reactor(){
+  running = false;
+  uint64_t one = 1;
+  if(write(wakeFD,&one,sizeof(one)) < 0){
+    //the reactor wakes up on its idle timeout anyway
+  }
+  thread.join();
+  //Anything still queued or in flight fails
+  TakeSubmitted();
+  for(size_t iSession = 0; iSession < active.size();iSession++){
+    if(active[iSession] != NULL){
+      Close(active[iSession]);
+    }
+  }
+  close(wakeFD);
+  close(epollFD);
+}
+
+int BNL_UDP_Reactor::AddSession(std::string const & address, uint16_t port_offset){
+  if(port_offset > 128){
+    BUException::BNL_UDP_PORT_OUT_OF_RANGE e;
+    throw e;
+  }
+  struct addrinfo * res;
+  if(getaddrinfo(address.c_str(),NULL,NULL,&res)){
+    BUException::BAD_REMOTE_IP e;
+    e.Append("Addr: ");
+    e.Append(address.c_str());
+    e.Append(" could not be resolved.\n");
+    throw e;
+  }
+  struct sockaddr_in addr = *((struct sockaddr_in *) res->ai_addr);
+  freeaddrinfo(res);
+
+  Session * session = new Session;
+  session->address = address;
+  session->portOffset = port_offset;
+  session->removed = false;
+  session->window = WIB_DEFAULT_READ_WINDOW;
+  try{
+    session->channel[REACTOR_READ_CHANNEL].fd = open_channel(addr,WIB_RD_BASE_PORT + port_offset);
+  }catch(BUException::exBase & e){
+    delete session;
+    throw;
+  }
+  try{
+    session->channel[REACTOR_WRITE_CHANNEL].fd = open_channel(addr,WIB_WR_BASE_PORT + port_offset);
+  }catch(BUException::exBase & e){
+    close(session->channel[REACTOR_READ_CHANNEL].fd);
+    delete session;
+    throw;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  int id = sessions.size();
+  sessions.push_back(session);
+  for(int iChannel = 0; iChannel < 2;iChannel++){
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = uint64_t(id)*2 + iChannel;
+    epoll_ctl(epollFD,EPOLL_CTL_ADD,session->channel[iChannel].fd,&event);
+  }
+  return id;
+}
+
+void BNL_UDP_Reactor::RemoveSession(int session){
+  Session * removed = GetSession(session);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    removed->removed = true;
+  }
+  uint64_t one = 1;
+  if(write(wakeFD,&one,sizeof(one)) < 0){
+    //counter overflow only, the reactor is already awake
+  }
+}
+
+BNL_UDP_Reactor::Session * BNL_UDP_Reactor::GetSession(int session){
+  std::lock_guard<std::mutex> lock(mutex);
+  if(session < 0 || size_t(session) >= sessions.size() || sessions[session] == NULL || sessions[session]->removed){
+    BUException::BAD_SOCKET e;
+    e.Append("unknown reactor session\n");
+    throw e;
+  }
+  return sessions[session];
+}
+
+void BNL_UDP_Reactor::SetWindow(int session, size_t window){
+  GetSession(session)->window = (window > 0) ? window : 1;
+}
+
+BNL_UDP_Stats const & BNL_UDP_Reactor::GetStats(int session){
+  return GetSession(session)->stats;
+}
+
+void BNL_UDP_Reactor::ClearStats(int session){
+  GetSession(session)->stats.Clear();
+}
+
+void BNL_UDP_Reactor::Submit(Request const & request){
+  GetSession(request.session);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    submitted.push_back(request);
+  }
+  uint64_t one = 1;
+  if(write(wakeFD,&one,sizeof(one)) < 0){
+    //counter overflow only, the reactor is already awake
+  }
+}
+
+void BNL_UDP_Reactor::Read(int session, uint16_t address, Completion done, uint8_t retry_count){
+  Request request;
+  request.session = session;
+  request.write = false;
+  request.address = address;
+  request.value = 0;
+  request.attempt = 0;
+  request.retry_count = (retry_count > 0) ? retry_count : 1;
+  request.sent = request.deadline = 0;
+  request.done = done;
+  Submit(request);
+}
+
+void BNL_UDP_Reactor::Write(int session, uint16_t address, uint32_t value, Completion done, uint8_t retry_count){
+  Request request;
+  request.session = session;
+  request.write = true;
+  request.address = address;
+  request.value = value;
+  request.attempt = 0;
+  request.retry_count = (retry_count > 0) ? retry_count : 1;
+  request.sent = request.deadline = 0;
+  request.done = done;
+  Submit(request);
+}
+
+static std::exception_ptr reply_failure(char const * what, uint16_t address){
+  BUException::BAD_REPLY e;
+  char description[64];
+  snprintf(description,sizeof(description),"BNL_UDP_Reactor::%s 0x%04X\n",what,address);
+  e.Append(description);
+  return std::make_exception_ptr(e);
+}
+
+std::future<uint32_t> BNL_UDP_Reactor::Read(int session, uint16_t address, uint8_t retry_count){
+  std::shared_ptr<std::promise<uint32_t> > promise(new std::promise<uint32_t>);
+  Read(session,address,[promise,address](bool success, uint32_t value){
+      if(success){
+	promise->set_value(value);
+      }else{
+	promise->set_exception(reply_failure("Read",address));
+      }
+    },retry_count);
+  return promise->get_future();
+}
+
+std::future<void> BNL_UDP_Reactor::Write(int session, uint16_t address, uint32_t value, uint8_t retry_count){
+  std::shared_ptr<std::promise<void> > promise(new std::promise<void>);
+  Write(session,address,value,[promise,address](bool success, uint32_t){
+      if(success){
+	promise->set_value();
+      }else{
+	promise->set_exception(reply_failure("Write",address));
+      }
+    },retry_count);
+  return promise->get_future();
+}
+
+std::future<std::vector<uint32_t> > BNL_UDP_Reactor::Read(int session, std::vector<uint16_t> const & addresses, uint8_t retry_count){
+  //Completions all run on the reactor thread, so the shared state needs no lock
+  struct BulkRead{
+    std::promise<std::vector<uint32_t> > promise;
+    std::vector<uint32_t> values;
+    size_t remaining;
+    bool failed;
+  };
+  std::shared_ptr<BulkRead> bulk(new BulkRead);
+  bulk->values.resize(addresses.size());
+  bulk->remaining = addresses.size();
+  bulk->failed = false;
+  std::future<std::vector<uint32_t> > result = bulk->promise.get_future();
+  if(addresses.empty()){
+    bulk->promise.set_value(bulk->values);
+    return result;
+  }
+  for(size_t i = 0; i < addresses.size();i++){
+    uint16_t address = addresses[i];
+    Read(session,address,[bulk,i,address](bool success, uint32_t value){
+	if(!success && !bulk->failed){
+	  bulk->failed = true;
+	  bulk->promise.set_exception(reply_failure("Read",address));
+	}
+	bulk->values[i] = value;
+	if(--bulk->remaining == 0 && !bulk->failed){
+	  bulk->promise.set_value(bulk->values);
+	}
+      },retry_count);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+//Reactor thread
+//------------------------------------------------------------------------------
+
+void BNL_UDP_Reactor::TakeSubmitted(){
+  std::vector<Request> requests;
+  std::vector<Session *> removed;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.swap(submitted);
+    for(size_t iSession = 0; iSession < sessions.size();iSession++){
+      if(sessions[iSession] != NULL && sessions[iSession]->removed){
+	removed.push_back(sessions[iSession]);
+	sessions[iSession] = NULL;
+      }
+    }
+    active = sessions;
+  }
+  for(size_t i = 0; i < requests.size();i++){
+    Session * session = active[requests[i].session];
+    if(session == NULL){
+      //Queued just before its session was removed
+      complete(requests[i].done,false,0);
+      continue;
+    }
+    session->channel[requests[i].write ? REACTOR_WRITE_CHANNEL : REACTOR_READ_CHANNEL].queued.push_back(requests[i]);
+  }
+  for(size_t iSession = 0; iSession < removed.size();iSession++){
+    Close(removed[iSession]);
+  }
+}
+
+void BNL_UDP_Reactor::Close(Session * session){
+  //Everything still queued or in flight fails
+  for(int iChannel = 0; iChannel < 2;iChannel++){
+    Channel & channel = session->channel[iChannel];
+    for(size_t i = 0; i < channel.inflight.size();i++){
+      complete(channel.inflight[i].done,false,0);
+    }
+    for(size_t i = 0; i < channel.queued.size();i++){
+      complete(channel.queued[i].done,false,0);
+    }
+    epoll_ctl(epollFD,EPOLL_CTL_DEL,channel.fd,NULL);
+    close(channel.fd);
+  }
+  delete session;
+}
+
+void BNL_UDP_Reactor::Send(Session & session, int iChannel, Request & request, uint64_t now){
+  uint8_t packet[WIB_REQUEST_PACKET_SIZE];
+  BuildWIBRequest(packet,request.address,request.value);
+  request.sent = now;
+  request.deadline = now + session.retryPolicy.Timeout(request.attempt);
+  //A failed send (e.g. ICMP error queued on the socket) is left to the timeout and retry
+  if(send(session.channel[iChannel].fd,packet,sizeof(packet),0) == sizeof(packet)){
+    session.stats.packets_sent++;
+    session.stats.bytes_sent += sizeof(packet);
+  }
+}
+
+void BNL_UDP_Reactor::Issue(Session & session, int iChannel, uint64_t now){
+  Channel & channel = session.channel[iChannel];
+  //Writes go out one at a time: a resent write must not land after later writes
+  //(e.g. an I2C control word after its RUN bit). Only reads use the window.
+  size_t window = (iChannel == REACTOR_WRITE_CHANNEL) ? 1 : size_t(session.window);
+  while(!channel.queued.empty() && channel.inflight.size() < window){
+    Request & request = channel.queued.front();
+    //Replies are matched by address, so only one request per address is in flight
+    bool busy = false;
+    for(size_t i = 0; i < channel.inflight.size();i++){
+      if(channel.inflight[i].address == request.address){
+	busy = true;
+	break;
+      }
+    }
+    if(busy){
+      break;
+    }
+    if(!session.retryPolicy.Allow()){
+      session.stats.fail_fast++;
+      Completion done = request.done;
+      channel.queued.pop_front();
+      complete(done,false,0);
+      continue;
+    }
+    Send(session,iChannel,request,now);
+    channel.inflight.push_back(request);
+    channel.queued.pop_front();
+  }
+}
+
+void BNL_UDP_Reactor::Receive(Session & session, int iChannel){
+  Channel & channel = session.channel[iChannel];
+  uint8_t reply[64];
+  while(true){
+    ssize_t size = recv(channel.fd,reply,sizeof(reply),MSG_DONTWAIT);
+    if(size < 0){
+      //EAGAIN: drained. Other errors (ICMP unreachable) are left to the timeouts
+      if(errno == EAGAIN || errno == EWOULDBLOCK){
+	return;
+      }
+      continue;
+    }
+    session.stats.packets_received++;
+    session.stats.bytes_received += size;
+    if(size < WIB_RPLY_PACKET_SIZE){
+      session.stats.short_replies++;
+      continue;
+    }
+    uint16_t address = WIBReplyAddress(reply);
+    uint32_t value = WIBReplyValue(reply);
+    size_t i = 0;
+    while(i < channel.inflight.size() && channel.inflight[i].address != address){
+      i++;
+    }
+    if(i == channel.inflight.size()){
+      //Late reply to a request we already retried or gave up on
+      session.stats.bad_address++;
+      continue;
+    }
+    Request request = channel.inflight[i];
+    channel.inflight[i] = channel.inflight.back();
+    channel.inflight.pop_back();
+    uint64_t rtt = now_us() - request.sent;
+    //Only first attempts give a clean RTT sample
+    session.retryPolicy.RecordSuccess((request.attempt == 0) ? ((rtt > 0) ? rtt : 1) : 0);
+    if(request.write){
+      session.stats.write_latency.Record(rtt);
+    }else{
+      session.stats.read_latency.Record(rtt);
+    }
+    complete(request.done,true,value);
+  }
+}
+
+void BNL_UDP_Reactor::Expire(Session & session, int iChannel, uint64_t now){
+  Channel & channel = session.channel[iChannel];
+  //A window of requests sent together tends to expire together: tell the policy
+  //about one loss per pass so a single stall doesn't trip the circuit breaker
+  bool lossRecorded = false;
+  for(size_t i = 0; i < channel.inflight.size();){
+    Request & request = channel.inflight[i];
+    if(request.deadline > now){
+      i++;
+      continue;
+    }
+    session.stats.timeouts++;
+    if(!lossRecorded){
+      session.retryPolicy.RecordTimeout();
+      lossRecorded = true;
+    }
+    if((request.attempt+1 < request.retry_count) && session.retryPolicy.AllowRetry(request.attempt+1)){
+      session.stats.retries++;
+      session.stats.retry_timeout++;
+      request.attempt++;
+      Send(session,iChannel,request,now);
+      i++;
+      continue;
+    }
+    Completion done = request.done;
+    channel.inflight[i] = channel.inflight.back();
+    channel.inflight.pop_back();
+    complete(done,false,0);
+  }
+}
+
+uint64_t BNL_UDP_Reactor::NextDeadline(){
+  uint64_t next = UINT64_MAX;
+  for(size_t iSession = 0; iSession < active.size();iSession++){
+    if(active[iSession] == NULL){
+      continue;
+    }
+    for(int iChannel = 0; iChannel < 2;iChannel++){
+      std::vector<Request> const & inflight = active[iSession]->channel[iChannel].inflight;
+      for(size_t i = 0; i < inflight.size();i++){
+	if(inflight[i].deadline < next){
+	  next = inflight[i].deadline;
+	}
+      }
+    }
+  }
+  return next;
+}
+
+void BNL_UDP_Reactor::Run(){
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+  while(running){
+    uint64_t now = now_us();
+    uint64_t next = NextDeadline();
+    int timeout_ms = REACTOR_IDLE_MS;
+    if(next != UINT64_MAX){
+      uint64_t wait = (next > now) ? (next - now + 999)/1000 : 0;
+      if(wait < uint64_t(timeout_ms)){
+	timeout_ms = wait;
+      }
+    }
+    int nEvents = epoll_wait(epollFD,events,REACTOR_MAX_EVENTS,timeout_ms);
+    for(int iEvent = 0; iEvent < nEvents;iEvent++){
+      uint64_t tag = events[iEvent].data.u64;
+      if(tag == REACTOR_WAKE_TAG){
+	uint64_t count;
+	if(read(wakeFD,&count,sizeof(count)) < 0){
+	  //already drained
+	}
+	TakeSubmitted();
+	continue;
+      }
+      if(tag/2 < active.size() && active[tag/2] != NULL){
+	Receive(*active[tag/2],tag%2);
+      }
+    }
+    //Timeouts and retries, then fill the windows back up
+    now = now_us();
+    for(size_t iSession = 0; iSession < active.size();iSession++){
+      if(active[iSession] == NULL){
+	continue;
+      }
+      for(int iChannel = 0; iChannel < 2;iChannel++){
+	Expire(*active[iSession],iChannel,now);
+	Issue(*active[iSession],iChannel,now);
+      }
+    }
+  }
+}
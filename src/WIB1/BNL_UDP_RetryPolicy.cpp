@@ -0,0 +1,106 @@
+#include "wibmod/WIB1/BNL_UDP_RetryPolicy.hh"
+#include "wibmod/WIB1/BNL_UDP.hh"
+#include <time.h> //clock_gettime
+#include <algorithm> //std::min, std::max
+
+static uint64_t now_us(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return uint64_t(ts.tv_sec)*1000000 + uint64_t(ts.tv_nsec)/1000;
+}
+
+BNL_UDP_RetryPolicy::BNL_UDP_RetryPolicy():minTimeout(WIB_RETRY_MIN_RTO_US),
+					 maxTimeout(WIB_DEFAULT_TIMEOUT_US){
+  Reset();
+}
+
+void BNL_UDP_RetryPolicy::Reset(){
+  haveSample = false;
+  srtt = 0;
+  rttvar = 0;
+  rto = std::max(minTimeout,std::min(uint32_t(WIB_RETRY_INITIAL_RTO_US),maxTimeout));
+  budget = WIB_RETRY_BUDGET_MAX;
+  consecutiveTimeouts = 0;
+  down = false;
+  lastProbe = 0;
+}
+
+void BNL_UDP_RetryPolicy::SetMaxTimeout(uint32_t us){
+  maxTimeout = std::max(us,uint32_t(1));
+  minTimeout = std::min(minTimeout,maxTimeout);
+  rto = std::max(minTimeout,std::min(rto,maxTimeout));
+}
+
+void BNL_UDP_RetryPolicy::SetMinTimeout(uint32_t us){
+  minTimeout = std::min(us,maxTimeout);
+  rto = std::max(minTimeout,std::min(rto,maxTimeout));
+}
+
+uint32_t BNL_UDP_RetryPolicy::Timeout(uint8_t attempt){
+  //exponential backoff of the RTO, capped at the max timeout
+  uint64_t timeout = uint64_t(rto) << std::min(attempt,uint8_t(16));
+  return uint32_t(std::min(timeout,uint64_t(maxTimeout)));
+}
+
+uint32_t BNL_UDP_RetryPolicy::Backoff(uint8_t attempt){
+  if(attempt == 0){
+    return 0;
+  }
+  uint64_t backoff = uint64_t(WIB_RETRY_BACKOFF_BASE_US) << std::min(attempt - 1,16);
+  return uint32_t(std::min(backoff,uint64_t(WIB_RETRY_BACKOFF_MAX_US)));
+}
+
+bool BNL_UDP_RetryPolicy::Allow(){
+  if(!down){
+    return true;
+  }
+  //Let one probe through per interval to notice the remote coming back
+  uint64_t now = now_us();
+  if(now - lastProbe >= WIB_RETRY_PROBE_INTERVAL_US){
+    lastProbe = now;
+    return true;
+  }
+  return false;
+}
+
+bool BNL_UDP_RetryPolicy::AllowRetry(uint8_t attempt){
+  if(attempt < WIB_RETRY_BASELINE_ATTEMPTS){
+    return true;
+  }
+  if(down || budget < 1.0){
+    return false;
+  }
+  budget -= 1.0;
+  return true;
+}
+
+void BNL_UDP_RetryPolicy::RecordSuccess(uint32_t rtt_us){
+  consecutiveTimeouts = 0;
+  down = false;
+  budget = std::min(budget + WIB_RETRY_BUDGET_REFILL,WIB_RETRY_BUDGET_MAX);
+  if(rtt_us == 0){
+    return;
+  }
+  //RFC 6298 section 2 (alpha = 1/8, beta = 1/4, K = 4)
+  if(!haveSample){
+    srtt = rtt_us;
+    rttvar = rtt_us/2;
+    haveSample = true;
+  }else{
+    uint32_t delta = (srtt > rtt_us) ? (srtt - rtt_us) : (rtt_us - srtt);
+    rttvar = (3*uint64_t(rttvar) + delta)/4;
+    srtt   = (7*uint64_t(srtt) + rtt_us)/8;
+  }
+  uint64_t newRTO = uint64_t(srtt) + 4*uint64_t(rttvar);
+  rto = uint32_t(std::max(uint64_t(minTimeout),std::min(newRTO,uint64_t(maxTimeout))));
+}
+
+void BNL_UDP_RetryPolicy::RecordTimeout(){
+  consecutiveTimeouts++;
+  if(consecutiveTimeouts >= WIB_RETRY_DOWN_THRESHOLD){
+    if(!down){
+      lastProbe = now_us();
+    }
+    down = true;
+  }
+}
@@ -0,0 +1,67 @@
+#include "wibmod/WIB1/BNL_UDP_Stats.hh"
+
+void BNL_UDP_LatencyHistogram::Clear(){
+  for(size_t iBucket = 0; iBucket < WIB_LATENCY_BUCKETS;iBucket++){
+    counts[iBucket].store(0,std::memory_order_relaxed);
+  }
+  count.store(0,std::memory_order_relaxed);
+  sum.store(0,std::memory_order_relaxed);
+  max.store(0,std::memory_order_relaxed);
+}
+
+void BNL_UDP_LatencyHistogram::AddTo(uint64_t * buckets) const{
+  for(size_t iBucket = 0; iBucket < WIB_LATENCY_BUCKETS;iBucket++){
+    buckets[iBucket] += counts[iBucket].load(std::memory_order_relaxed);
+  }
+}
+
+uint64_t BNL_UDP_LatencyHistogram::BucketLowerBound(size_t bucket){
+  if(bucket < WIB_LATENCY_SUB_BUCKETS){
+    return bucket;
+  }
+  size_t shift = (bucket >> WIB_LATENCY_SUB_BUCKET_BITS) - 1;
+  uint64_t sub = bucket & (WIB_LATENCY_SUB_BUCKETS - 1);
+  return (uint64_t(WIB_LATENCY_SUB_BUCKETS) + sub) << shift;
+}
+
+uint64_t BNL_UDP_LatencyHistogram::Percentile(uint64_t const * buckets, double fraction){
+  uint64_t total = 0;
+  for(size_t iBucket = 0; iBucket < WIB_LATENCY_BUCKETS;iBucket++){
+    total += buckets[iBucket];
+  }
+  if(total == 0){
+    return 0;
+  }
+  uint64_t target = uint64_t(fraction*total + 0.5);
+  if(target == 0){
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for(size_t iBucket = 0; iBucket < WIB_LATENCY_BUCKETS;iBucket++){
+    seen += buckets[iBucket];
+    if(seen >= target){
+      //upper edge of the bucket
+      return (iBucket + 1 < WIB_LATENCY_BUCKETS) ? BucketLowerBound(iBucket + 1) - 1 : BucketLowerBound(iBucket);
+    }
+  }
+  return BucketLowerBound(WIB_LATENCY_BUCKETS - 1);
+}
+
+void BNL_UDP_Stats::Clear(){
+  retries = 0;
+  retry_timeout = 0;
+  retry_error = 0;
+  timeouts = 0;
+  bad_address = 0;
+  short_replies = 0;
+  stale_drains = 0;
+  fail_fast = 0;
+  block_write_failures = 0;
+  per_word_writes = 0;
+  packets_sent = 0;
+  bytes_sent = 0;
+  packets_received = 0;
+  bytes_received = 0;
+  read_latency.Clear();
+  write_latency.Clear();
+}
@@ -0,0 +1,49 @@
+#include "wibmod/WIB1/MemoryTransport.hh"
+
+//Same accounting as a BNL_UDP request/reply pair
+#define MEM_REQUEST_BYTES 12
+#define MEM_REPLY_BYTES 12
+
+uint32_t MemoryTransport::ReadWithRetry(uint16_t address,uint8_t /*retry_count*/){
+  return Read(address);
+}
+
+uint32_t MemoryTransport::Read(uint16_t address){
+  stats.packets_sent++;
+  stats.bytes_sent += MEM_REQUEST_BYTES;
+  stats.packets_received++;
+  stats.bytes_received += MEM_REPLY_BYTES;
+  stats.read_latency.Record(0);
+  return model.Read(address);
+}
+
+std::vector<uint32_t> MemoryTransport::ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t /*retry_count*/){
+  return Read(addresses);
+}
+
+std::vector<uint32_t> MemoryTransport::Read(std::vector<uint16_t> const & addresses){
+  std::vector<uint32_t> values(addresses.size());
+  for(size_t i = 0; i < addresses.size();i++){
+    values[i] = Read(addresses[i]);
+  }
+  return values;
+}
+
+void MemoryTransport::WriteWithRetry(uint16_t address, uint32_t value, uint8_t /*retry_count*/){
+  Write(address,value);
+}
+
+void MemoryTransport::Write(uint16_t address,uint32_t value){
+  Write(address,&value,1);
+}
+
+void MemoryTransport::Write(uint16_t address,uint32_t const * values, size_t word_count){
+  for(size_t iWord = 0; iWord < word_count;iWord++){
+    model.Write(address + iWord,values[iWord]);
+  }
+  stats.packets_sent++;
+  stats.bytes_sent += 4 + 6*word_count + 2;
+  stats.packets_received++;
+  stats.bytes_received += MEM_REPLY_BYTES;
+  stats.write_latency.Record(0);
+}
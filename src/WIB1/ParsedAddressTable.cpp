@@ -0,0 +1,109 @@
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+#include <stdlib.h>  //getenv
+#include <stdio.h>
+#include <inttypes.h>
+#include <mutex>
+
+//Tables already parsed in this process, keyed by file name and table directory.
+//Weak references, so a table is freed with the last AddressTable using it.
+static std::mutex cacheMutex;
+static std::map<std::string,std::weak_ptr<ParsedAddressTable const> > cache;
+
+//The same file name can resolve to a different file with another $WIBMOD_SHARE
+static std::string table_key(std::string const & fileName){
+  std::string key = fileName;
+  key += '\n';
+  if(getenv("WIBMOD_SHARE") != NULL){
+    key += getenv("WIBMOD_SHARE");
+  }
+  return key;
+}
+
+std::shared_ptr<ParsedAddressTable const> ParsedAddressTable::Get(std::string const & fileName){
+  std::string key = table_key(fileName);
+
+  //Held across the parse so concurrent constructions of the same table parse it once
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::shared_ptr<ParsedAddressTable const> table = cache[key].lock();
+  if(!table){
+    std::string image = ImagePath(fileName);
+    if(!image.empty()){
+      std::shared_ptr<ParsedAddressTable> loaded(new ParsedAddressTable);
+      bool good = false;
+      try{
+	good = loaded->LoadImage(image);
+      }catch(BUException::exBase &){
+	//A damaged image is rebuilt below
+	good = false;
+      }
+      if(good){
+	loaded->Finalize();
+	table = loaded;
+      }
+    }
+    if(!table){
+      table = Parse(fileName);
+      if(!image.empty()){
+	try{
+	  table->WriteImage(image);
+	}catch(BUException::exBase & e){
+	  //The cache is only an optimization
+	  fprintf(stderr,"Warning: %s",e.Description());
+	}
+      }
+    }
+    cache[key] = table;
+  }
+  return table;
+}
+
+std::shared_ptr<ParsedAddressTable const> ParsedAddressTable::Parse(std::string const & fileName){
+  //shared_ptr owns it from here so a parse error cleans up the partial table
+  std::shared_ptr<ParsedAddressTable> parsed(new ParsedAddressTable);
+  parsed->LoadFile(fileName);
+  parsed->Finalize();
+  return parsed;
+}
+
+std::string ParsedAddressTable::ImagePath(std::string const & fileName){
+  if(getenv("WIBMOD_ADT_CACHE") == NULL || getenv("WIBMOD_ADT_CACHE")[0] == '\0'){
+    return "";
+  }
+  //Same table name from a different table directory gets its own image
+  std::string key = table_key(fileName);
+  std::string baseName = fileName.substr(fileName.rfind('/') == std::string::npos ? 0 : fileName.rfind('/')+1);
+  char hash[20];
+  snprintf(hash,sizeof(hash),"%016" PRIx64,HashName(key));
+  std::string path = getenv("WIBMOD_ADT_CACHE");
+  path += "/";
+  path += baseName;
+  path += ".";
+  path += hash;
+  path += ".adtc";
+  return path;
+}
+
+ParsedAddressTable::ParsedAddressTable(){
+  fileLevel = 0;
+  nameIndexCount = 0;
+  fingerprint = 0;
+}
+
+void ParsedAddressTable::Finalize(){
+  ComputeFingerprint();
+  BuildSearchIndexes();
+  BuildShadowPolicy();
+}
+
+ParsedAddressTable::~ParsedAddressTable(){
+  for(std::map<uint32_t,std::vector<Item*> >::iterator itAddress = addressItemMap.begin();
+      itAddress != addressItemMap.end();
+      itAddress++){
+    std::vector<Item*> & items = itAddress->second;
+    for(size_t iItem = 0; iItem < items.size();iItem++){
+      //sc_conv is shared (ItemConversion::Get)
+      delete items[iItem];
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#include "wibmod/WIB1/ReactorTransport.hh"
+#include "wibmod/WIB1/BNL_UDP_Reactor.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+
+#include <future>
+
+BNL_UDP_Reactor & ReactorTransport::SharedReactor(){
+  static BNL_UDP_Reactor reactor;
+  return reactor;
+}
+
+ReactorTransport::ReactorTransport(std::string const & _remote, uint16_t port_offset):remote(_remote),session(-1){
+  session = SharedReactor().AddSession(remote,port_offset);
+}
+
+ReactorTransport::~ReactorTransport(){
+  try{
+    SharedReactor().RemoveSession(session);
+  }catch(BUException::exBase & e){
+    //already gone
+  }
+}
+
+uint32_t ReactorTransport::ReadWithRetry(uint16_t address,uint8_t retry_count){
+  return SharedReactor().Read(session,address,retry_count).get();
+}
+
+uint32_t ReactorTransport::Read(uint16_t address){
+  return ReadWithRetry(address,1);
+}
+
+std::vector<uint32_t> ReactorTransport::ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count){
+  return SharedReactor().Read(session,addresses,retry_count).get();
+}
+
+std::vector<uint32_t> ReactorTransport::Read(std::vector<uint16_t> const & addresses){
+  return ReadWithRetry(addresses,1);
+}
+
+void ReactorTransport::WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count){
+  SharedReactor().Write(session,address,value,retry_count).get();
+}
+
+void ReactorTransport::Write(uint16_t address,uint32_t value){
+  WriteWithRetry(address,value,1);
+}
+
+void ReactorTransport::Write(uint16_t address,uint32_t const * values, size_t word_count){
+  //Queue every word before waiting so they go out back to back; wait for all of them
+  //before reporting the first failure so nothing is left completing behind the caller
+  std::vector<std::future<void> > writes;
+  writes.reserve(word_count);
+  for(size_t iWord = 0; iWord < word_count;iWord++){
+    writes.push_back(SharedReactor().Write(session,address + iWord,values[iWord],1));
+  }
+  std::exception_ptr failure;
+  for(size_t iWord = 0; iWord < writes.size();iWord++){
+    try{
+      writes[iWord].get();
+    }catch(...){
+      if(!failure){
+	failure = std::current_exception();
+      }
+    }
+  }
+  if(failure){
+    std::rethrow_exception(failure);
+  }
+}
+
+BNL_UDP_Stats const & ReactorTransport::GetStats(){
+  return SharedReactor().GetStats(session);
+}
+
+void ReactorTransport::ClearStats(){
+  SharedReactor().ClearStats(session);
+}
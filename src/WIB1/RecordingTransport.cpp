@@ -0,0 +1,198 @@
+#include "wibmod/WIB1/RecordingTransport.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+static uint64_t clock_us(clockid_t clock){
+  struct timespec ts;
+  clock_gettime(clock,&ts);
+  return uint64_t(ts.tv_sec)*1000000 + uint64_t(ts.tv_nsec)/1000;
+}
+
+static uint64_t realtime_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME,&ts);
+  return uint64_t(ts.tv_sec)*1000000000 + uint64_t(ts.tv_nsec);
+}
+
+RecordingTransport::RecordingTransport(RegisterTransport * _transport, std::string const & logFile, uint16_t port_offset):
+  transport(_transport),portOffset(port_offset),logFD(-1),buffered(0){
+  logFD = open(logFile.c_str(),O_WRONLY | O_CREAT | O_APPEND,0644);
+  if(logFD < 0){
+    delete transport;
+    BUException::BAD_FILE e;
+    e.Append(logFile.c_str());
+    e.Append(": ");
+    e.Append(strerror(errno));
+    e.Append("\n");
+    throw e;
+  }
+  //New file: start it with the header (an existing log is appended to)
+  if(lseek(logFD,0,SEEK_END) == 0){
+    TransactionLogHeader header;
+    memcpy(header.magic,WIB_TRANSACTION_LOG_MAGIC,sizeof(header.magic));
+    header.version = WIB_TRANSACTION_LOG_VERSION;
+    header.record_size = sizeof(TransactionRecord);
+    if(write(logFD,&header,sizeof(header)) != sizeof(header)){
+      close(logFD);
+      delete transport;
+      BUException::BAD_FILE e;
+      e.Append(logFile.c_str());
+      e.Append(": can't write transaction log header\n");
+      throw e;
+    }
+  }
+}
+
+RecordingTransport::~RecordingTransport(){
+  Flush();
+  close(logFD);
+  delete transport;
+}
+
+void RecordingTransport::Flush(){
+  if(buffered == 0){
+    return;
+  }
+  //One append per flush, O_APPEND keeps chunks from different transports whole
+  if(write(logFD,buffer,buffered*sizeof(TransactionRecord)) < 0){
+    fprintf(stderr,"RecordingTransport: lost %zu transaction records: %s\n",buffered,strerror(errno));
+  }
+  buffered = 0;
+}
+
+RecordingTransport::Call RecordingTransport::Begin(){
+  Call call;
+  call.timestamp_ns = realtime_ns();
+  call.start_us = clock_us(CLOCK_MONOTONIC);
+  call.retries = transport->GetStats().retries;
+  return call;
+}
+
+void RecordingTransport::Add(Call const & call, uint8_t op, uint16_t address, uint32_t value, uint8_t flags){
+  if(buffered == WIB_TRANSACTION_LOG_BUFFER){
+    Flush();
+  }
+  TransactionRecord & record = buffer[buffered++];
+  record.timestamp_ns = call.timestamp_ns;
+  record.value = value;
+  uint64_t latency = clock_us(CLOCK_MONOTONIC) - call.start_us;
+  record.latency_us = (latency > 0xFFFFFFFF) ? 0xFFFFFFFF : latency;
+  record.address = address;
+  record.port_offset = portOffset;
+  record.op = op;
+  uint64_t retries = transport->GetStats().retries - call.retries;
+  if((flags & TransactionRecord::BULK) && !(flags & TransactionRecord::BULK_START)){
+    retries = 0;
+  }
+  record.retries = (retries > 0xFF) ? 0xFF : retries;
+  record.flags = flags;
+  record.reserved = 0;
+}
+
+uint32_t RecordingTransport::ReadWithRetry(uint16_t address,uint8_t retry_count){
+  Call call = Begin();
+  uint32_t value;
+  try{
+    value = transport->ReadWithRetry(address,retry_count);
+  }catch(...){
+    Add(call,TransactionRecord::READ,address,0,TransactionRecord::RETRY | TransactionRecord::FAILED);
+    throw;
+  }
+  Add(call,TransactionRecord::READ,address,value,TransactionRecord::RETRY);
+  return value;
+}
+
+uint32_t RecordingTransport::Read(uint16_t address){
+  Call call = Begin();
+  uint32_t value;
+  try{
+    value = transport->Read(address);
+  }catch(...){
+    Add(call,TransactionRecord::READ,address,0,TransactionRecord::FAILED);
+    throw;
+  }
+  Add(call,TransactionRecord::READ,address,value,0);
+  return value;
+}
+
+std::vector<uint32_t> RecordingTransport::ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count){
+  Call call = Begin();
+  std::vector<uint32_t> values;
+  uint8_t flags = TransactionRecord::BULK | TransactionRecord::RETRY;
+  try{
+    values = transport->ReadWithRetry(addresses,retry_count);
+  }catch(...){
+    if(!addresses.empty()){
+      Add(call,TransactionRecord::READ,addresses[0],0,flags | TransactionRecord::BULK_START | TransactionRecord::FAILED);
+    }
+    throw;
+  }
+  for(size_t i = 0; i < values.size();i++){
+    Add(call,TransactionRecord::READ,addresses[i],values[i],flags | ((i == 0) ? TransactionRecord::BULK_START : 0));
+  }
+  return values;
+}
+
+std::vector<uint32_t> RecordingTransport::Read(std::vector<uint16_t> const & addresses){
+  Call call = Begin();
+  std::vector<uint32_t> values;
+  uint8_t flags = TransactionRecord::BULK;
+  try{
+    values = transport->Read(addresses);
+  }catch(...){
+    if(!addresses.empty()){
+      Add(call,TransactionRecord::READ,addresses[0],0,flags | TransactionRecord::BULK_START | TransactionRecord::FAILED);
+    }
+    throw;
+  }
+  for(size_t i = 0; i < values.size();i++){
+    Add(call,TransactionRecord::READ,addresses[i],values[i],flags | ((i == 0) ? TransactionRecord::BULK_START : 0));
+  }
+  return values;
+}
+
+void RecordingTransport::WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count){
+  Call call = Begin();
+  try{
+    transport->WriteWithRetry(address,value,retry_count);
+  }catch(...){
+    Add(call,TransactionRecord::WRITE,address,value,TransactionRecord::RETRY | TransactionRecord::FAILED);
+    throw;
+  }
+  Add(call,TransactionRecord::WRITE,address,value,TransactionRecord::RETRY);
+}
+
+void RecordingTransport::Write(uint16_t address,uint32_t value){
+  Call call = Begin();
+  try{
+    transport->Write(address,value);
+  }catch(...){
+    Add(call,TransactionRecord::WRITE,address,value,TransactionRecord::FAILED);
+    throw;
+  }
+  Add(call,TransactionRecord::WRITE,address,value,0);
+}
+
+void RecordingTransport::Write(uint16_t address,uint32_t const * values, size_t word_count){
+  Call call = Begin();
+  uint8_t flags = (word_count > 1) ? uint8_t(TransactionRecord::BULK) : 0;
+  try{
+    transport->Write(address,values,word_count);
+  }catch(...){
+    for(size_t iWord = 0; iWord < word_count;iWord++){
+      uint8_t start = (flags && iWord == 0) ? uint8_t(TransactionRecord::BULK_START) : 0;
+      Add(call,TransactionRecord::WRITE,address+iWord,values[iWord],flags | start | TransactionRecord::FAILED);
+    }
+    throw;
+  }
+  for(size_t iWord = 0; iWord < word_count;iWord++){
+    uint8_t start = (flags && iWord == 0) ? uint8_t(TransactionRecord::BULK_START) : 0;
+    Add(call,TransactionRecord::WRITE,address+iWord,values[iWord],flags | start);
+  }
+}
@@ -0,0 +1,79 @@
+#include "wibmod/WIB1/RegisterModel.hh"
+#include "wibmod/WIB1/AddressTable.hh"
+
+static bool reads_good(std::string const & name){
+  //Status flags the configuration code waits on
+  std::string field = name.substr(name.rfind('.') == std::string::npos ? 0 : name.rfind('.')+1);
+  if(field.find("LOCKED") != std::string::npos){
+    return true;
+  }
+  char const * suffixes[] = {"DONE","READY","EMPTY"};
+  for(size_t iSuffix = 0; iSuffix < sizeof(suffixes)/sizeof(suffixes[0]);iSuffix++){
+    std::string suffix(suffixes[iSuffix]);
+    if(field.size() >= suffix.size() &&
+       0 == field.compare(field.size()-suffix.size(),suffix.size(),suffix)){
+      return true;
+    }
+  }
+  return false;
+}
+
+void RegisterModel::Seed(AddressTable & table){
+  std::vector<std::string> names = table.GetNames();
+  //First pass: masks
+  boost::unordered_map<uint16_t,uint32_t> writableMasks;
+  for(size_t iName = 0; iName < names.size();iName++){
+    Item const * item = table.GetItem(names[iName]);
+    Register & reg = registers[item->address];
+    if(item->mode & (Item::WRITE | Item::ACTION)){
+      writableMasks[item->address] |= item->mask;
+    }else if(item->mode & Item::READ){
+      reg.readOnlyMask |= item->mask;
+    }
+    if(item->mode & Item::ACTION){
+      reg.actionMask |= item->mask;
+    }
+  }
+  //Bits that are writable through any item are not read-only
+  for(boost::unordered_map<uint16_t,uint32_t>::iterator it = writableMasks.begin();
+      it != writableMasks.end();it++){
+    registers[it->first].readOnlyMask &= ~(it->second);
+  }
+  //Second pass: status values
+  for(size_t iName = 0; iName < names.size();iName++){
+    Item const * item = table.GetItem(names[iName]);
+    std::string field = names[iName].substr(names[iName].rfind('.') == std::string::npos ? 0 : names[iName].rfind('.')+1);
+    if(field == "PDTS_STATE"){
+      Set(item,8);
+    }else if(field == "FEMB_COUNT" || field == "DAQ_LINK_COUNT"){
+      //Present as RCE firmware (4 FEMBs, 4 DAQ links)
+      Set(item,4);
+    }else if((item->mode & Item::READ) && !(item->mode & Item::WRITE) && reads_good(names[iName])){
+      Set(item,0xFFFFFFFF);
+    }
+  }
+}
+
+uint32_t RegisterModel::Read(uint16_t address){
+  boost::unordered_map<uint16_t,Register>::iterator it = registers.find(address);
+  if(it == registers.end()){
+    return 0;
+  }
+  return it->second.value;
+}
+
+void RegisterModel::Write(uint16_t address, uint32_t value){
+  Register & reg = registers[address];
+  reg.value = (reg.value & reg.readOnlyMask) | (value & ~reg.readOnlyMask);
+  //Action bits pulse and are cleared by the firmware
+  reg.value &= ~reg.actionMask;
+}
+
+void RegisterModel::Set(uint16_t address, uint32_t value){
+  registers[address].value = value;
+}
+
+void RegisterModel::Set(Item const * item, uint32_t value){
+  Register & reg = registers[item->address];
+  reg.value = (reg.value & ~item->mask) | ((value << item->offset) & item->mask);
+}
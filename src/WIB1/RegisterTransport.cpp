@@ -0,0 +1,60 @@
+#include "wibmod/WIB1/RegisterTransport.hh"
+#include "wibmod/WIB1/BNL_UDP.hh"
+#include "wibmod/WIB1/MemoryTransport.hh"
+#include "wibmod/WIB1/ReactorTransport.hh"
+#include "wibmod/WIB1/RecordingTransport.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+
+static RegisterTransport * create_base(std::string const & address, uint16_t port_offset){
+  std::string scheme = "udp";
+  std::string remote = address;
+  size_t schemeEnd = address.find("://");
+  if(schemeEnd != std::string::npos){
+    scheme = address.substr(0,schemeEnd);
+    remote = address.substr(schemeEnd+3);
+  }
+
+  if(scheme == "udp"){
+    BNL_UDP * udp = new BNL_UDP;
+    try{
+      udp->Setup(remote,port_offset);
+    }catch(BUException::exBase & e){
+      delete udp;
+      throw;
+    }
+    udp->SetWriteAck(true);
+    return udp;
+  }else if(scheme == "mem"){
+    //Keep the port offset in the name so the WIB and each FEMB are told apart
+    char offsetString[] = "@0x0000";
+    snprintf(offsetString,sizeof(offsetString),"@0x%X",port_offset);
+    return new MemoryTransport(remote + offsetString);
+  }else if(scheme == "reactor"){
+    return new ReactorTransport(remote,port_offset);
+  }
+
+  BUException::BAD_TRANSPORT e;
+  e.Append("Address: ");
+  e.Append(address.c_str());
+  e.Append("\n");
+  throw e;
+}
+
+RegisterTransport * RegisterTransport::Create(std::string const & address, uint16_t port_offset){
+  size_t queryStart = address.find('?');
+  if(queryStart == std::string::npos){
+    return create_base(address,port_offset);
+  }
+
+  std::string query = address.substr(queryStart+1);
+  if(query.compare(0,7,"record=") != 0 || query.size() == 7){
+    BUException::BAD_TRANSPORT e;
+    e.Append("Unknown option in address: ");
+    e.Append(address.c_str());
+    e.Append("\n");
+    throw e;
+  }
+  RegisterTransport * transport = create_base(address.substr(0,queryStart),port_offset);
+  //RecordingTransport owns (and cleans up) transport from here on
+  return new RecordingTransport(transport,query.substr(7),port_offset);
+}
@@ -0,0 +1,60 @@
+#include "wibmod/WIB1/TransactionLog.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+static_assert(sizeof(TransactionLogHeader) == 16,"transaction log header layout changed");
+static_assert(sizeof(TransactionRecord) == 24,"transaction log record layout changed");
+
+TransactionLogFile::TransactionLogFile(std::string const & path):map(MAP_FAILED),mapSize(0),records(NULL),count(0){
+  int fd = open(path.c_str(),O_RDONLY);
+  if(fd < 0){
+    BUException::BAD_FILE e;
+    e.Append(path.c_str());
+    e.Append(": ");
+    e.Append(strerror(errno));
+    e.Append("\n");
+    throw e;
+  }
+  struct stat st;
+  if(fstat(fd,&st) < 0 || size_t(st.st_size) < sizeof(TransactionLogHeader)){
+    close(fd);
+    BUException::BAD_FILE e;
+    e.Append(path.c_str());
+    e.Append(": too short for a transaction log\n");
+    throw e;
+  }
+  mapSize = st.st_size;
+  map = mmap(NULL,mapSize,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map == MAP_FAILED){
+    BUException::BAD_FILE e;
+    e.Append(path.c_str());
+    e.Append(": mmap failed\n");
+    throw e;
+  }
+  TransactionLogHeader const * header = (TransactionLogHeader const *) map;
+  if(memcmp(header->magic,WIB_TRANSACTION_LOG_MAGIC,sizeof(header->magic)) != 0 ||
+     header->version != WIB_TRANSACTION_LOG_VERSION ||
+     header->record_size != sizeof(TransactionRecord)){
+    munmap(map,mapSize);
+    BUException::BAD_FILE e;
+    e.Append(path.c_str());
+    e.Append(": not a version 1 transaction log\n");
+    throw e;
+  }
+  records = (TransactionRecord const *) ((char const *) map + sizeof(TransactionLogHeader));
+  //A partly written trailing record (crash during append) is ignored
+  count = (mapSize - sizeof(TransactionLogHeader))/sizeof(TransactionRecord);
+}
+
+TransactionLogFile::~TransactionLogFile(){
+  if(map != MAP_FAILED){
+    munmap(map,mapSize);
+  }
+}
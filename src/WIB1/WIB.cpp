@@ -4,12 +4,17 @@
 #include <stdio.h> //snprintf
 #include <iostream>
 
+//How long a lock/status bit must read good after a reset or clock switch before it is believed
+//(the old value can still be visible right after the write)
+#define WIB_RESET_SETTLE_US 2000
+#define WIB_CLOCK_SETTLE_US 100000
+
 
 
 WIB::WIB(std::string const & address, std::string const & WIBAddressTable, std::string const & FEMBAddressTable, bool fullStart): 
   WIBBase(address,WIBAddressTable,FEMBAddressTable),DAQMode(UNKNOWN),FEMBStreamCount(4),FEMBCDACount(2),
   ContinueOnFEMBRegReadError(false),ContinueOnFEMBSPIError(false),ContinueOnFEMBSyncError(true),
-  ContinueIfListOfFEMBClockPhasesDontSync(true){
+  ContinueIfListOfFEMBClockPhasesDontSync(true),PDTSPollInterval(1000){
 
 
   if(fullStart){
@@ -75,6 +80,12 @@ void WIB::EnableDAQLink(uint8_t iDAQLink){
 }
 
 void WIB::EnableDAQLink_Lite(uint8_t iDAQLink, uint8_t enable){
+  WriteBatch batch = Batch();
+  EnableDAQLink_Lite(batch,iDAQLink,enable);
+  batch.Commit();
+}
+
+void WIB::EnableDAQLink_Lite(WriteBatch & batch,uint8_t iDAQLink, uint8_t enable){
   //CHeck if we know how to dael with this firmware
   if(!((DAQMode == RCE)||(DAQMode == FELIX))){
     //Not RCE or FELIX firmware, return
@@ -94,8 +105,8 @@ void WIB::EnableDAQLink_Lite(uint8_t iDAQLink, uint8_t enable){
     else stream = 0xFF;   
   }
 
-  Write(base+"ENABLE_CDA_STREAM",stream);
-  Write(base+"ENABLE",enable);
+  batch.Write(base+"ENABLE_CDA_STREAM",stream);
+  batch.Write(base+"ENABLE",enable);
 }
 
 /*void WIB::DisableDAQLink_Lite(uint8_t iDAQLink, uint8_t enable){
@@ -159,6 +170,7 @@ void WIB::ResetWIB(bool reset_udp){
   //Reset the control register
   WriteWithRetry("SYSTEM.RESET.CONTROL_REGISTER_RESET",1);
   usleep(1000);
+  InvalidateShadowRegisters();
 
   //If this is felix, make sure we configure the SI5342
   if(DAQMode == FELIX){
@@ -168,14 +180,14 @@ void WIB::ResetWIB(bool reset_udp){
     usleep(10000);
     printf("Configuring SI5342 for FELIX\n");
     LoadConfigDAQ_SI5342("default"); //use the default config file for the SI5342
-    usleep(10000);      // Wait for 
+    CheckWaitFor("DAQ.SI5342.LOL",0,10000,1000,WIB_RESET_SETTLE_US);
     SelectSI5342(1,     // Set input to be local oscillator for FELIX clock
 		 1);    // enable the output of the SI5342
   }
 
   //Reset the Eventbuilder PLL
   Write("SYSTEM.RESET.EB_PLL_RESET",1);
-  usleep(10000);
+  CheckWaitFor("SYSTEM.EB_LOCKED",1,10000,1000,WIB_RESET_SETTLE_US);
   
   //Reset the DAQ path
   Write("SYSTEM.RESET.DAQ_PATH_RESET",1);  
@@ -194,6 +206,28 @@ void WIB::ResetWIB(bool reset_udp){
   Write("POWER.ENABLE.MASTER_BIAS",1);
 }
 
+void WIB::RequireWaitFor(std::string_view address, uint32_t value, uint32_t timeout_us,
+			 uint32_t poll_interval_us, uint32_t hold_us){
+  if(!WaitFor(address,value,timeout_us,poll_interval_us,hold_us)){
+    BUException::WIB_ERROR e;
+    char expected[] = " == 0xFFFFFFFF (4294967295 us)\n";
+    snprintf(expected,sizeof(expected)," == 0x%X (%u us)\n",value,timeout_us);
+    e.Append("Timed out waiting for ");
+    e.Append(std::string(address).c_str());
+    e.Append(expected);
+    throw e;
+  }
+}
+
+bool WIB::CheckWaitFor(std::string_view address, uint32_t value, uint32_t timeout_us,
+		       uint32_t poll_interval_us, uint32_t hold_us){
+  bool met = WaitFor(address,value,timeout_us,poll_interval_us,hold_us);
+  if(!met){
+    printf("Warning: timed out waiting for %s == 0x%X (%u us), continuing\n",std::string(address).c_str(),value,timeout_us);
+  }
+  return met;
+}
+
 void WIB::ResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_t PDTSsource, uint32_t PDTSAlignment_timeout){
   if(DAQMode == UNKNOWN){
     BUException::WIB_DAQMODE_UNKNOWN e;
@@ -214,6 +248,7 @@ void WIB::ResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_t PDTSs
     e.Append("PDTS TGRP > 15; must be 0 to 15\n");
     throw e;    
   }
+  ClearWaitLog();
 
   // get this register so we can leave it in the state it started in
   uint32_t slow_control_dnd = Read("SYSTEM.SLOW_CONTROL_DND");
@@ -230,20 +265,22 @@ void WIB::ResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_t PDTSs
   Write("DTS.CONVERT_CONTROL.HALT",1);  
   Write("DTS.CONVERT_CONTROL.ENABLE",0);  
   Write("DTS.CONVERT_CONTROL.START_SYNC",0);  
-  sleep(1);
+  CheckWaitFor("FEMB_CNC.PASSING_CONVERTS",0,1000000);
  
   if(localClock > 0){
     printf("Configuring local clock\n");
     //Configure the SI5344 to use the local oscillator instead of the PDTS
-    LoadConfigDTS_SI5344("default");
-    sleep(1);
+    if(LoadConfigDTS_SI5344("default")){
+      //Only a new configuration needs time to settle
+      CheckWaitFor("DTS.SI5344.LOL",0,1000000,1000,WIB_CLOCK_SETTLE_US);
+    }
     SelectSI5344(1,1);
-    sleep(1);
+    CheckWaitFor("DTS.SI5344.STATUS",0,1000000,1000,WIB_CLOCK_SETTLE_US);
     Write("DTS.CONVERT_CONTROL.EN_FAKE",1);  
     Write("DTS.CONVERT_CONTROL.LOCAL_TIMESTAMP",1);  
     Write("FEMB_CNC.CNC_CLOCK_SELECT",1);  
     //    Write("FEMB_CNC.ENABLE_DTS_CMDS",1);  
-    sleep(1);
+    RequireWaitFor("FEMB_CNC.LOCKED",1,1000000,1000,WIB_CLOCK_SETTLE_US);
   }
   else {
     //Configure the clocking for the PDTS (assumes the PDTS is sending idle or something)
@@ -251,12 +288,12 @@ void WIB::ResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_t PDTSs
     Write("DTS.PDTS_TGRP",PDTS_TGRP);
     printf("Using timing group 0x%X\n",PDTS_TGRP);
     InitializeDTS(PDTSsource,0,PDTSAlignment_timeout);
-    sleep(1);
+    RequireWaitFor("DTS.PDTS_STATE",0x8,1000000);
     Write("FEMB_CNC.CNC_CLOCK_SELECT",1);  
-    sleep(1);
+    RequireWaitFor("FEMB_CNC.LOCKED",1,1000000,1000,WIB_CLOCK_SETTLE_US);
     //We are ready for the PDTS, start searching
     Write("DTS.PDTS_ENABLE",1);  
-    sleep(1);
+    RequireWaitFor("DTS.PDTS_STATE",0x8,1000000,1000,WIB_CLOCK_SETTLE_US);
   }
  
   //Now we have the 128MHz clock
@@ -289,18 +326,24 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
     e.Append("PDTS TGRP > 15; must be 0 to 15\n");
     throw e;    
   }
+  ClearWaitLog();
 
 
   bool reset_check = false;
   // Check if we are already in a good state
   if(localClock > 0){
     printf("Checking if locked on local clock\n");
-    reset_check = (  (Read("DTS.CONVERT_CONTROL.EN_FAKE") != 1) 
-                  || (Read("DTS.CCONVERT_CONTROL.LOCAL_TIMESTAMP") != 1)
-                  || (Read("FEMB_CNC.CNC_CLOCK_SELECT") != 1) 
+    RegisterSnapshot state = SnapshotNames({"DTS.CONVERT_CONTROL.EN_FAKE",
+					    "DTS.CONVERT_CONTROL.LOCAL_TIMESTAMP",
+					    "FEMB_CNC.CNC_CLOCK_SELECT",
+					    "DTS.SI5344.INPUT_SELECT",
+					    "DTS.SI5344.ENABLE"});
+    reset_check = (  (state.Get("DTS.CONVERT_CONTROL.EN_FAKE") != 1) 
+                  || (state.Get("DTS.CONVERT_CONTROL.LOCAL_TIMESTAMP") != 1)
+                  || (state.Get("FEMB_CNC.CNC_CLOCK_SELECT") != 1) 
 		     //                  || (Read("FEMB_CNC.ENABLE_DTS_CMDS") != 1) 
-                  || (Read("DTS.SI5344.INPUT_SELECT") != 1)
-                  || (Read("DTS.SI5344.ENABLE") != 1) );                  
+                  || (state.Get("DTS.SI5344.INPUT_SELECT") != 1)
+                  || (state.Get("DTS.SI5344.ENABLE") != 1) );                  
     if(!reset_check){
       printf("Already in a good state\n"); 
     }
@@ -310,16 +353,27 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
   }
   else{
     printf("Checking if locked on PDTS\n");
-    reset_check = (  (Read("DTS.PDTS_TGRP") != PDTS_TGRP) 
-                  || (Read("FEMB_CNC.CNC_CLOCK_SELECT") != 1)
-                  || (Read("DTS.PDTS_ENABLE") != 1)
-                  || (Read("DTS.CDS.LOL") != 0)
-                  || (Read("DTS.CDS.LOS") != 0)
-                  || (ReadWithRetry("DTS.SI5344.INPUT_SELECT") != 0)
-                  || (ReadWithRetry("DTS.SI5344.LOS") != 0)
-                  || (ReadWithRetry("DTS.SI5344.LOL") != 0)
-                  || (ReadWithRetry("DTS.SI5344.ENABLE") != 1)
-                  || (ReadWithRetry("DTS.PDTS_STATE") != 0x8) );
+    RegisterSnapshot state = SnapshotNames({"DTS.PDTS_TGRP",
+					    "FEMB_CNC.CNC_CLOCK_SELECT",
+					    "DTS.PDTS_ENABLE",
+					    "DTS.CDS.LOL",
+					    "DTS.CDS.LOS",
+					    "DTS.SI5344.INPUT_SELECT",
+					    "DTS.SI5344.LOS",
+					    "DTS.SI5344.LOL",
+					    "DTS.SI5344.ENABLE",
+					    "DTS.PDTS_STATE"},
+					   true);
+    reset_check = (  (state.Get("DTS.PDTS_TGRP") != PDTS_TGRP) 
+                  || (state.Get("FEMB_CNC.CNC_CLOCK_SELECT") != 1)
+                  || (state.Get("DTS.PDTS_ENABLE") != 1)
+                  || (state.Get("DTS.CDS.LOL") != 0)
+                  || (state.Get("DTS.CDS.LOS") != 0)
+                  || (state.Get("DTS.SI5344.INPUT_SELECT") != 0)
+                  || (state.Get("DTS.SI5344.LOS") != 0)
+                  || (state.Get("DTS.SI5344.LOL") != 0)
+                  || (state.Get("DTS.SI5344.ENABLE") != 1)
+                  || (state.Get("DTS.PDTS_STATE") != 0x8) );
     if(!reset_check){
       printf("Already in a good state\n");      
     }
@@ -331,12 +385,17 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
   //Check the SI5342 if we're attached to FELIX
   if(DAQMode == FELIX){
          
+    RegisterSnapshot si5342 = SnapshotNames({"DAQ.SI5342.ENABLE",
+					     "DAQ.SI5342.INPUT_SELECT",
+					     "DAQ.SI5342.LOL",
+					     "DAQ.SI5342.LOS_XAXB",
+					     "DAQ.SI5342.LOS_2"});
     if( 
-        (Read("DAQ.SI5342.ENABLE") == 0)
-        || (Read("DAQ.SI5342.INPUT_SELECT") != 1) 
-        || (Read("DAQ.SI5342.LOL") == 1) 
-        || (Read("DAQ.SI5342.LOS_XAXB") == 1) 
-        || (Read("DAQ.SI5342.LOS_2") == 1) ){
+        (si5342.Get("DAQ.SI5342.ENABLE") == 0)
+        || (si5342.Get("DAQ.SI5342.INPUT_SELECT") != 1) 
+        || (si5342.Get("DAQ.SI5342.LOL") == 1) 
+        || (si5342.Get("DAQ.SI5342.LOS_XAXB") == 1) 
+        || (si5342.Get("DAQ.SI5342.LOS_2") == 1) ){
       printf("Need to reset for SI5342\n"); 
       reset_check = true;
     }
@@ -357,23 +416,29 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
     }
     
     //make sure everything DTS is off
-    Write("DTS.CONVERT_CONTROL.HALT",1);  
-    Write("DTS.CONVERT_CONTROL.ENABLE",0);  
-    Write("DTS.CONVERT_CONTROL.START_SYNC",0);  
-    sleep(1);
+    Batch()
+      .Write("DTS.CONVERT_CONTROL.HALT",1)
+      .Write("DTS.CONVERT_CONTROL.ENABLE",0)
+      .Write("DTS.CONVERT_CONTROL.START_SYNC",0)
+      .Commit();
+    CheckWaitFor("FEMB_CNC.PASSING_CONVERTS",0,1000000);
   
     if(localClock > 0){
       printf("Configuring local clock\n");
       //Configure the SI5344 to use the local oscillator instead of the PDTS
-      LoadConfigDTS_SI5344("default");
-      sleep(1);
+      if(LoadConfigDTS_SI5344("default")){
+	//Only a new configuration needs time to settle
+	CheckWaitFor("DTS.SI5344.LOL",0,1000000,1000,WIB_CLOCK_SETTLE_US);
+      }
       SelectSI5344(1,1);
-      sleep(1);
-      Write("DTS.CONVERT_CONTROL.EN_FAKE",1);  
-      Write("DTS.CONVERT_CONTROL.LOCAL_TIMESTAMP",1);  
-      Write("FEMB_CNC.CNC_CLOCK_SELECT",1);  
+      CheckWaitFor("DTS.SI5344.STATUS",0,1000000,1000,WIB_CLOCK_SETTLE_US);
+      Batch()
+	.Write("DTS.CONVERT_CONTROL.EN_FAKE",1)
+	.Write("DTS.CONVERT_CONTROL.LOCAL_TIMESTAMP",1)
+	.Write("FEMB_CNC.CNC_CLOCK_SELECT",1)
+	.Commit();
       //      Write("FEMB_CNC.ENABLE_DTS_CMDS",1);  
-      sleep(1);
+      RequireWaitFor("FEMB_CNC.LOCKED",1,1000000,1000,WIB_CLOCK_SETTLE_US);
     }
     else {
       //Configure the clocking for the PDTS (assumes the PDTS is sending idle or something)
@@ -381,12 +446,12 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
       Write("DTS.PDTS_TGRP",PDTS_TGRP);
       printf("Using timing group 0x%X\n",PDTS_TGRP);
       InitializeDTS(PDTSsource,0,PDTSAlignment_timeout);
-      sleep(1);
+      RequireWaitFor("DTS.PDTS_STATE",0x8,1000000);
       Write("FEMB_CNC.CNC_CLOCK_SELECT",1);  
-      sleep(1);
+      RequireWaitFor("FEMB_CNC.LOCKED",1,1000000,1000,WIB_CLOCK_SETTLE_US);
       //We are ready for the PDTS, start searching
       Write("DTS.PDTS_ENABLE",1);  
-      sleep(1);
+      RequireWaitFor("DTS.PDTS_STATE",0x8,1000000,1000,WIB_CLOCK_SETTLE_US);
     }
   
   
@@ -396,15 +461,17 @@ void WIB::CheckedResetWIBAndCfgDTS(uint8_t localClock, uint8_t PDTS_TGRP, uint8_
   std::cout << "Resetting DAQ Links" << std::endl;
   size_t nLinks = 4;
   if(DAQMode == FELIX){ nLinks = 2; }
+  WriteBatch batch = Batch();
   for (size_t iLink=1; iLink <= nLinks; ++iLink){
     std::cout << iLink << std::endl;
-    EnableDAQLink_Lite(iLink, 0);
+    EnableDAQLink_Lite(batch, iLink, 0);
   }
 
-  Write("FEMB1.DAQ.ENABLE",0);  
-  Write("FEMB2.DAQ.ENABLE",0);  
-  Write("FEMB3.DAQ.ENABLE",0);  
-  Write("FEMB4.DAQ.ENABLE",0);  
+  batch.Write("FEMB1.DAQ.ENABLE",0);  
+  batch.Write("FEMB2.DAQ.ENABLE",0);  
+  batch.Write("FEMB3.DAQ.ENABLE",0);  
+  batch.Write("FEMB4.DAQ.ENABLE",0);  
+  batch.Commit();
 
 }
 
@@ -413,38 +480,42 @@ void WIB::StartStreamToDAQ(bool link1_enabled, bool link2_enabled, bool link3_en
     BUException::WIB_DAQMODE_UNKNOWN e;
     throw e;    
   }
-  WriteWithRetry("DTS.CONVERT_CONTROL.HALT",1);
-  WriteWithRetry("DTS.CONVERT_CONTROL.ENABLE",0);
+  Batch()
+    .Write("DTS.CONVERT_CONTROL.HALT",1)
+    .Write("DTS.CONVERT_CONTROL.ENABLE",0)
+    .Commit(true);
 
 
   // get this register so we can leave it in the state it started in
   uint32_t slow_control_dnd = Read("SYSTEM.SLOW_CONTROL_DND");
   Write("SYSTEM.SLOW_CONTROL_DND",1);
 
-  sleep(1);
+  CheckWaitFor("FEMB_CNC.PASSING_CONVERTS",0,1000000);
   Write("FEMB_CNC.FEMB_STOP",1);  
   sleep(1);
   Write("SYSTEM.RESET.DAQ_PATH_RESET",1);  
   sleep(1);
 
   // Enable DAQ links
+  WriteBatch batch = Batch();
   if (DAQMode == FELIX){
-    if(link1_enabled) EnableDAQLink_Lite(1,1);
-    if(link2_enabled) EnableDAQLink_Lite(2,1);
+    if(link1_enabled) EnableDAQLink_Lite(batch,1,1);
+    if(link2_enabled) EnableDAQLink_Lite(batch,2,1);
   }
   else {
-    if(link3_enabled) EnableDAQLink_Lite(3,1);
-    if(link4_enabled) EnableDAQLink_Lite(4,1);
+    if(link3_enabled) EnableDAQLink_Lite(batch,3,1);
+    if(link4_enabled) EnableDAQLink_Lite(batch,4,1);
   }
 
   // Enable the FEMB to align to idle and wait for convert
-  Write("FEMB1.DAQ.ENABLE",0xF);  
-  Write("FEMB2.DAQ.ENABLE",0xF);  
-  Write("FEMB3.DAQ.ENABLE",0xF);  
-  Write("FEMB4.DAQ.ENABLE",0xF);  
+  batch.Write("FEMB1.DAQ.ENABLE",0xF);  
+  batch.Write("FEMB2.DAQ.ENABLE",0xF);  
+  batch.Write("FEMB3.DAQ.ENABLE",0xF);  
+  batch.Write("FEMB4.DAQ.ENABLE",0xF);  
 
   // Start sending characters from the FEMB
-  Write("FEMB_CNC.ENABLE_DTS_CMDS",1);  
+  batch.Write("FEMB_CNC.ENABLE_DTS_CMDS",1);  
+  batch.Commit();
   StartSyncDTS();
   //  Write("FEMB_CNC.TIMESTAMP_RESET",1);  
   //Write("FEMB_CNC.FEMB_START",1);  
@@ -461,6 +532,8 @@ void WIB::FEMBPower(uint8_t iFEMB,bool turnOn){
   }else{
     Write(reg,0x0);  
   }
+  //A power cycled FEMB comes back with its default registers
+  InvalidateFEMBShadowRegisters(iFEMB);
 }
 
 //void WIB::PowerOnFEMB(uint8_t iFEMB){
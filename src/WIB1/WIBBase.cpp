@@ -2,6 +2,16 @@
 #include "wibmod/WIB1/WIBException.hh"
 #include "wibmod/WIB1/BNL_UDP_Exception.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <unistd.h> //usleep
+
+//Adaptive I2C completion poll: re-read at once, then sleep this long, doubling up to the max
+#define I2C_POLL_MIN_US 10
+#define I2C_POLL_MAX_US 1000
+//Longest a transaction may take before DONE; a 4 byte transfer at 100kHz is well under a millisecond
+#define I2C_DONE_TIMEOUT_US 100000
+
 WIBBase::WIBBase(std::string const & address, std::string const & WIBAddressTable, std::string const & FEMBAddressTable):
   wib(NULL), FEMBReadSleepTime(0.01), FEMBWriteSleepTime(0.01) {
   //Make sure all pointers and NULL before any allocation
@@ -36,26 +46,264 @@ std::string WIBBase::GetAddress(){
 }
 
 
+WIBBase::I2CRegisters & WIBBase::GetI2CRegisters(std::string const & base_address){
+  boost::unordered_map<std::string,I2CRegisters>::iterator it = i2cRegisters.find(base_address);
+  if(it != i2cRegisters.end()){
+    return it->second;
+  }
+  I2CRegisters regs;
+  regs.rw         = Resolve(base_address+".RW");
+  regs.addr       = Resolve(base_address+".ADDR");
+  regs.byte_count = Resolve(base_address+".BYTE_COUNT");
+  regs.wr_data    = Resolve(base_address+".WR_DATA");
+  regs.rd_data    = Resolve(base_address+".RD_DATA");
+  regs.done       = Resolve(base_address+".DONE");
+  regs.run        = Resolve(base_address+".RUN");
+  regs.error      = Resolve(base_address+".ERROR");
+  regs.reset      = Resolve(base_address+".RESET");
+  RegisterHandle const * control[] = {&regs.rw,&regs.addr,&regs.byte_count,&regs.run,&regs.done,&regs.error,&regs.reset};
+  regs.singleShot = true;
+  uint32_t fields = 0;
+  for(size_t iField = 0; iField < sizeof(control)/sizeof(control[0]);iField++){
+    if(control[iField]->address != regs.rw.address || (fields & control[iField]->mask)){
+      regs.singleShot = false;
+    }
+    fields |= control[iField]->mask;
+  }
+  regs.idle = false;
+  return i2cRegisters[base_address] = regs;
+}
+
+uint32_t WIBBase::I2CControlWord(I2CRegisters const & i2c, bool read, uint16_t I2C_address, uint8_t byte_count){
+  return ((i2c.rw.mask         & (uint32_t(read ? 1 : 0) << i2c.rw.offset)) |
+	  (i2c.addr.mask       & (uint32_t(I2C_address) << i2c.addr.offset)) |
+	  (i2c.byte_count.mask & (uint32_t(byte_count) << i2c.byte_count.offset)));
+}
+
+bool WIBBase::WaitI2CDone(I2CRegisters const & i2c, uint32_t & control, uint32_t * rd_data){
+  //Read the data along with the control register, it is valid once DONE is
+  std::vector<uint16_t> addresses(1,i2c.rw.address);
+  if(rd_data != NULL){
+    addresses.push_back(i2c.rd_data.address);
+  }
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(I2C_DONE_TIMEOUT_US);
+  useconds_t wait = 0;
+  while(true){
+    std::vector<uint32_t> values = ReadWithRetry(addresses);
+    control = values[0];
+    if(control & i2c.done.mask){
+      if(rd_data != NULL){
+	*rd_data = values[1];
+      }
+      return true;
+    }
+    if(std::chrono::steady_clock::now() >= deadline){
+      //The master is stuck
+      return false;
+    }
+    if(wait != 0){
+      usleep(wait);
+    }
+    wait = (wait == 0) ? I2C_POLL_MIN_US : std::min(2*wait,useconds_t(I2C_POLL_MAX_US));
+  }
+}
+
+bool WIBBase::SingleShotWriteI2C(I2CRegisters & i2c, uint16_t address, uint32_t data, uint8_t byte_count, bool block){
+  uint32_t words[2] = {I2CControlWord(i2c,false,address,byte_count),data};
+  bool written = false;
+  if(block && (i2c.wr_data.address == i2c.rw.address + 1)){
+    try{
+      Write(i2c.rw.address,words,2);
+      written = true;
+    }catch(BUException::BAD_REPLY & e){
+      //Unacknowledged block (or no block write support).  Neither word starts the transaction, so just
+      //write them again one at a time.
+    }
+  }
+  if(!written){
+    WriteWithRetry(i2c.rw.address,words[0]);
+    WriteWithRetry(i2c.wr_data.address,words[1]);
+  }
+  uint32_t control;
+  if(!i2c.idle && !WaitI2CDone(i2c,control)){
+    return false;
+  }
+  i2c.idle = false;
+  WriteWithRetry(i2c.rw.address,words[0] | i2c.run.mask);
+  if(!WaitI2CDone(i2c,control)){
+    return false;
+  }
+  i2c.idle = true;
+  return !(control & i2c.error.mask);
+}
+
+bool WIBBase::TryWriteI2C(I2CRegisters & i2c, std::string const & base_address, uint8_t address, uint8_t data){
+  try{
+    if(!i2c.singleShot){
+      //Throws (after resetting the master) on an I2C error
+      WriteI2C(base_address,address,data,1);
+      return true;
+    }
+    if(SingleShotWriteI2C(i2c,address,data,1,true)){
+      return true;
+    }
+    //Reset the I2C firmware
+    WriteWithRetry(i2c.reset,1);
+  }catch(BUException::exBase & e){
+    //I2C error or a lost packet
+    i2c.idle = false;
+  }
+  return false;
+}
+
+//Order of a burst's writes: by page, otherwise as given
+struct I2CPageOrder{
+  std::vector<WIBBase::I2CPagedWrite> const & writes;
+  bool operator()(size_t a, size_t b) const {return writes[a].page < writes[b].page;};
+};
+
+std::vector<size_t> WIBBase::WriteI2CBurst(std::string const & base_address, std::vector<I2CPagedWrite> const & writes,
+					   bool keep_order, uint8_t page_address, int tries){
+  I2CRegisters & i2c = GetI2CRegisters(base_address);
+
+  std::vector<size_t> order(writes.size());
+  for(size_t iWrite = 0; iWrite < writes.size();iWrite++){
+    order[iWrite] = iWrite;
+  }
+  if(!keep_order){
+    I2CPageOrder pageOrder = {writes};
+    std::stable_sort(order.begin(),order.end(),pageOrder);
+  }
+
+  std::vector<size_t> failed;
+  //The device's page is only known once we've written it
+  bool pageSet = false;
+  uint8_t page = 0;
+  for(size_t iOrder = 0; iOrder < order.size();iOrder++){
+    I2CPagedWrite const & write = writes[order[iOrder]];
+    bool ok = false;
+    for(int iTry = 0; iTry < tries && !ok;iTry++){
+      if(!pageSet || (page != write.page)){
+	page = write.page;
+	pageSet = TryWriteI2C(i2c,base_address,page_address,page);
+	if(!pageSet){
+	  continue;
+	}
+      }
+      ok = TryWriteI2C(i2c,base_address,write.address,write.data);
+    }
+    if(!ok){
+      failed.push_back(order[iOrder]);
+    }
+  }
+  std::sort(failed.begin(),failed.end());
+  return failed;
+}
+
+//Order of a burst's reads: by page, then address, so neighbouring registers share a transaction
+struct I2CAddressOrder{
+  std::vector<WIBBase::I2CPagedWrite> const & registers;
+  bool operator()(size_t a, size_t b) const {
+    return (registers[a].page < registers[b].page ||
+	    (registers[a].page == registers[b].page && registers[a].address < registers[b].address));
+  };
+};
+
+void WIBBase::ReadI2CBurst(std::string const & base_address, std::vector<I2CPagedWrite> & registers,
+			   uint8_t page_address, uint8_t max_bytes){
+  if((max_bytes < 1) || (max_bytes > 4)){
+    BUException::WIB_BAD_ARGS e;
+    e.Append("ReadI2CBurst max_bytes must be 1 to 4\n");
+    throw e;
+  }
+  std::vector<size_t> order(registers.size());
+  for(size_t iRegister = 0; iRegister < registers.size();iRegister++){
+    order[iRegister] = iRegister;
+  }
+  I2CAddressOrder addressOrder = {registers};
+  std::stable_sort(order.begin(),order.end(),addressOrder);
+
+  bool pageSet = false;
+  uint8_t page = 0;
+  size_t iOrder = 0;
+  while(iOrder < order.size()){
+    I2CPagedWrite const & first = registers[order[iOrder]];
+    //Consecutive addresses on the same page come back in one read (the device auto-increments)
+    size_t count = 1;
+    while((iOrder + count < order.size()) && (count < max_bytes) &&
+	  (registers[order[iOrder+count]].page == first.page) &&
+	  (registers[order[iOrder+count]].address == first.address + count)){
+      count++;
+    }
+    if(!pageSet || (page != first.page)){
+      page = first.page;
+      WriteI2C(base_address,page_address,page,1);
+      pageSet = true;
+    }
+    //First byte assumed in the low bits (see the header)
+    uint32_t data = ReadI2C(base_address,first.address,count);
+    for(size_t iByte = 0; iByte < count;iByte++){
+      registers[order[iOrder+iByte]].data = uint8_t((data >> (8*iByte)) & 0xFF);
+    }
+    iOrder += count;
+  }
+}
+
+void WIBBase::ThrowI2CError(I2CRegisters const & i2c, std::string const & base_address, char const * trans_info){
+  //Reset the I2C firmware
+  WriteWithRetry(i2c.reset,1);    
+  BUException::WIB_ERROR e;
+  e.Append("I2C Error on ");
+  e.Append(base_address.c_str());
+  e.Append(trans_info);
+  throw e;
+}
+
 uint32_t WIBBase::ReadI2C(std::string const & base_address ,uint16_t address, uint8_t byte_count){
-  //This is an incredibly inefficient version of this function since it does a dozen or so UDP transactions.
-  //This is done to be generic, but it could be hard-coded by assuming address offsets and bit maps and done in one write and one read.
+  //With the usual layout (see GetI2CRegisters) this is two control register writes and a poll that also fetches
+  //the data. Otherwise it falls back to the generic version below, which does a dozen or so UDP transactions.
+  I2CRegisters & i2c = GetI2CRegisters(base_address);
+  if(i2c.singleShot){
+    uint32_t control = I2CControlWord(i2c,true,address,byte_count);
+    WriteWithRetry(i2c.rw.address,control);
+    uint32_t status;
+    bool done = i2c.idle || WaitI2CDone(i2c,status);
+    uint32_t data = 0;
+    if(done){
+      i2c.idle = false;
+      WriteWithRetry(i2c.rw.address,control | i2c.run.mask);
+      done = WaitI2CDone(i2c,status,&data);
+      i2c.idle = done;
+    }
+    if(!done || (status & i2c.error.mask)){
+      if(done){
+	printf("%s 0x%08X\n",(base_address+".ERROR").c_str(),(status & i2c.error.mask) >> i2c.error.offset);
+      }else{
+	printf("%s timed out\n",(base_address+".DONE").c_str());
+      }
+      char trans_info[] = "rd @ 0xFFFF";
+      sprintf(trans_info,"rd @ 0x%04X",address&0xFFFF);
+      ThrowI2CError(i2c,base_address,trans_info);
+    }
+    return data;
+  }
 
    //Set type of read
-  WriteWithRetry(base_address+".RW",1);
+  WriteWithRetry(i2c.rw,1);
    //Set address
-  WriteWithRetry(base_address+".ADDR",address);
+  WriteWithRetry(i2c.addr,address);
   //Set read size
-  WriteWithRetry(base_address+".BYTE_COUNT",byte_count);
+  WriteWithRetry(i2c.byte_count,byte_count);
   //Wait for the last transaction to be done
-  while(ReadWithRetry(base_address+".DONE") == 0x0){usleep(1000);}
+  while(ReadWithRetry(i2c.done) == 0x0){usleep(1000);}
   //Run transaction
-  WriteWithRetry(base_address+".RUN",0x1);
+  WriteWithRetry(i2c.run,0x1);
   //Wait for the last transaction to be done
-  while(ReadWithRetry(base_address+".DONE") == 0x0){usleep(1000);}
-  if(ReadWithRetry(base_address+".ERROR")){
-    printf("%s 0x%08X\n",(base_address+".ERROR").c_str(),ReadWithRetry(base_address+".ERROR"));
+  while(ReadWithRetry(i2c.done) == 0x0){usleep(1000);}
+  if(ReadWithRetry(i2c.error)){
+    printf("%s 0x%08X\n",(base_address+".ERROR").c_str(),ReadWithRetry(i2c.error));
     //Reset the I2C firmware
-    WriteWithRetry(base_address+".RESET",1);    
+    WriteWithRetry(i2c.reset,1);    
     char trans_info[] = "rd @ 0xFFFF";
     sprintf(trans_info,"rd @ 0x%04X",address&0xFFFF);
     BUException::WIB_ERROR e;
@@ -64,31 +312,40 @@ uint32_t WIBBase::ReadI2C(std::string const & base_address ,uint16_t address, ui
     e.Append(trans_info);
     throw e;
   }
-  return ReadWithRetry(base_address+".RD_DATA");
+  return ReadWithRetry(i2c.rd_data);
 }
 void     WIBBase::WriteI2C(std::string const & base_address,uint16_t address, uint32_t data, uint8_t byte_count,bool ignore_error){
-  //This is an incredibly inefficient version of this function since it does a dozen or so UDP transactions.
-  //This is done to be generic, but it could be hard-coded by assuming address offsets and bit maps and done in one write and one read.
+  //With the usual layout (see GetI2CRegisters) this is three full word writes and a poll. Otherwise it falls
+  //back to the generic version below, which does a dozen or so UDP transactions.
+  I2CRegisters & i2c = GetI2CRegisters(base_address);
+  if(i2c.singleShot){
+    if(!SingleShotWriteI2C(i2c,address,data,byte_count,false) && !ignore_error){
+      char trans_info[] = "wr 0xFFFFFFFF @ 0xFFFF";
+      sprintf(trans_info,"wr 0x%08X @ 0x%04X",data,address&0xFFFF);
+      ThrowI2CError(i2c,base_address,trans_info);
+    }
+    return;
+  }
 
    //Set type of read
-  WriteWithRetry(base_address+".RW",0);
+  WriteWithRetry(i2c.rw,0);
   //Set address
-  WriteWithRetry(base_address+".ADDR",address);
+  WriteWithRetry(i2c.addr,address);
   //Set read size
-  WriteWithRetry(base_address+".BYTE_COUNT",byte_count);
+  WriteWithRetry(i2c.byte_count,byte_count);
   //Send data to write
-  WriteWithRetry(base_address+".WR_DATA",data);
+  WriteWithRetry(i2c.wr_data,data);
   //Wait for the last transaction to be done
-  while(ReadWithRetry(base_address+".DONE") == 0x0){usleep(1000);}
+  while(ReadWithRetry(i2c.done) == 0x0){usleep(1000);}
   //Run transaction
-  WriteWithRetry(base_address+".RUN",0x1);
+  WriteWithRetry(i2c.run,0x1);
 
   //Wait for the last transaction to be done
-  while(ReadWithRetry(base_address+".DONE") == 0x0){usleep(1000);}
+  while(ReadWithRetry(i2c.done) == 0x0){usleep(1000);}
 
-  if(!ignore_error && ReadWithRetry(base_address+".ERROR")){
+  if(!ignore_error && ReadWithRetry(i2c.error)){
     //Reset the I2C firmware
-    WriteWithRetry(base_address+".RESET",1);    
+    WriteWithRetry(i2c.reset,1);    
     char trans_info[] = "wr 0xFFFFFFFF @ 0xFFFF";
     sprintf(trans_info,"wr 0x%08X @ 0x%04X",data,address&0xFFFF);
     BUException::WIB_ERROR e;
@@ -99,12 +356,56 @@ void     WIBBase::WriteI2C(std::string const & base_address,uint16_t address, ui
   }
 }
 
+bool WIBBase::WaitFor(std::string_view address, std::function<bool(uint32_t)> const & predicate,
+		      uint32_t timeout_us, uint32_t poll_interval_us, uint32_t hold_us){
+  typedef std::chrono::steady_clock clock;
+  RegisterHandle handle = Resolve(address);
+  clock::time_point start = clock::now();
+  clock::time_point deadline = start + std::chrono::microseconds(timeout_us);
+  clock::time_point now = start;
+  //Time of the first read of the current run of reads that met predicate
+  clock::time_point metSince = start;
+  bool holding = false;
+  WaitRecord record = {std::string(address),0,0,false};
+  while(true){
+    uint32_t value = ReadWithRetry(handle);
+    record.reads++;
+    now = clock::now();
+    if(predicate(value)){
+      if(!holding){
+	metSince = now;
+	holding = true;
+      }
+      if(now - metSince >= std::chrono::microseconds(hold_us)){
+	record.met = true;
+	break;
+      }
+    }else{
+      holding = false;
+    }
+    if(now >= deadline){
+      break;
+    }
+    //Don't sleep past the deadline
+    uint64_t left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    usleep(std::min<uint64_t>(poll_interval_us,left));
+  }
+  record.time = std::chrono::duration<double>(now - start).count();
+  waitLog.push_back(record);
+  printf("Waited %.1f ms for %s (%u reads%s)\n",1000*record.time,record.address.c_str(),record.reads,
+	 record.met ? "" : ", timed out");
+  return record.met;
+}
+bool WIBBase::WaitFor(std::string_view address, uint32_t value, uint32_t timeout_us, uint32_t poll_interval_us,
+		      uint32_t hold_us){
+  return WaitFor(address,[value](uint32_t read){return read == value;},timeout_us,poll_interval_us,hold_us);
+}
 
-Item const * WIBBase::GetItem(std::string const & str){
+Item const * WIBBase::GetItem(std::string_view str){
   return wib->GetItem(str);
 }
 
-Item const * WIBBase::GetFEMBItem(int iFEMB,std::string const & str){
+Item const * WIBBase::GetFEMBItem(int iFEMB,std::string_view str){
   if((iFEMB > 4) || (iFEMB <1)){
     BUException::WIB_INDEX_OUT_OF_RANGE e;
     e.Append("In WIBBase::ReadFEMB\n");
@@ -119,12 +420,18 @@ uint32_t WIBBase::ReadWithRetry(uint16_t address){
 uint32_t WIBBase::Read(uint16_t address){
   return wib->Read(address);    
 }
-uint32_t WIBBase::ReadWithRetry(std::string const & address){
+uint32_t WIBBase::ReadWithRetry(std::string_view address){
   return wib->ReadWithRetry(address);    
 }
-uint32_t WIBBase::Read(std::string const & address){
+uint32_t WIBBase::Read(std::string_view address){
   return wib->Read(address);    
 }
+std::vector<uint32_t> WIBBase::Read(std::vector<uint16_t> const & addresses){
+  return wib->Read(addresses);    
+}
+std::vector<uint32_t> WIBBase::ReadWithRetry(std::vector<uint16_t> const & addresses){
+  return wib->ReadWithRetry(addresses);    
+}
 
 void WIBBase::WriteWithRetry(uint16_t address,uint32_t value){
   wib->WriteWithRetry(address,value);    
@@ -132,25 +439,102 @@ void WIBBase::WriteWithRetry(uint16_t address,uint32_t value){
 void WIBBase::Write(uint16_t address,uint32_t value){
   wib->Write(address,value);    
 }
-void WIBBase::WriteWithRetry(std::string const & address,uint32_t value){
+void WIBBase::WriteWithRetry(std::string_view address,uint32_t value){
   wib->WriteWithRetry(address,value);    
 }
-void WIBBase::Write(std::string const & address,uint32_t value){
+void WIBBase::Write(std::string_view address,uint32_t value){
   wib->Write(address,value);    
 }
 void WIBBase::Write(uint16_t address,std::vector<uint32_t> const & values){
   wib->Write(address,values);    
 }
-void WIBBase::Write(std::string const & address,std::vector<uint32_t> const & values){
+void WIBBase::Write(std::string_view address,std::vector<uint32_t> const & values){
   wib->Write(address,values);    
 }
 void WIBBase::Write(uint16_t address,uint32_t const * values,size_t word_count){
   wib->Write(address,values,word_count);    
 }
-void WIBBase::Write(std::string const & address,uint32_t const * values,size_t word_count){
+void WIBBase::Write(std::string_view address,uint32_t const * values,size_t word_count){
   wib->Write(address,values,word_count);    
 }
 
+RegisterHandle WIBBase::Resolve(std::string_view address){
+  return wib->Resolve(address);
+}
+RegisterHandle WIBBase::ResolveFEMB(int iFEMB,std::string_view address){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::ResolveFEMB\n");
+    throw e;
+  }
+  return FEMB[iFEMB-1]->Resolve(address);
+}
+RegisterSnapshot WIBBase::FEMBSnapshot(int iFEMB, std::string const & prefix, bool retry){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::FEMBSnapshot\n");
+    throw e;
+  }
+  return FEMB[iFEMB-1]->Snapshot(prefix,retry);
+}
+
+WriteBatch WIBBase::Batch(){
+  return WriteBatch(wib);
+}
+WriteBatch WIBBase::FEMBBatch(int iFEMB){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::FEMBBatch\n");
+    throw e;
+  }
+  return WriteBatch(FEMB[iFEMB-1]);
+}
+uint32_t WIBBase::Read(RegisterHandle const & handle){
+  return wib->Read(handle);
+}
+uint32_t WIBBase::ReadWithRetry(RegisterHandle const & handle){
+  return wib->ReadWithRetry(handle);
+}
+void WIBBase::Write(RegisterHandle const & handle,uint32_t value){
+  wib->Write(handle,value);
+}
+void WIBBase::WriteWithRetry(RegisterHandle const & handle,uint32_t value){
+  wib->WriteWithRetry(handle,value);
+}
+
+
+void WIBBase::EnableShadowRegisters(bool enable){
+  wib->EnableShadow(enable);
+  for(size_t iFEMB = 0; iFEMB < FEMB_COUNT;iFEMB++){
+    FEMB[iFEMB]->EnableShadow(enable);
+  }
+}
+void WIBBase::InvalidateShadowRegisters(){
+  wib->InvalidateShadow();
+  for(size_t iFEMB = 0; iFEMB < FEMB_COUNT;iFEMB++){
+    FEMB[iFEMB]->InvalidateShadow();
+  }
+}
+void WIBBase::InvalidateFEMBShadowRegisters(int iFEMB){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::InvalidateFEMBShadowRegisters\n");
+    throw e;
+  }
+  FEMB[iFEMB-1]->InvalidateShadow();
+}
+
+BNL_UDP_Stats const & WIBBase::GetTransportStats(){
+  return wib->GetStats();
+}
+BNL_UDP_Stats const & WIBBase::GetFEMBTransportStats(int iFEMB){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::GetFEMBTransportStats\n");
+    throw e;
+  }
+  return FEMB[iFEMB-1]->GetStats();
+}
 
 uint32_t WIBBase::ReadFEMB(int iFEMB,uint16_t address){
   if((iFEMB > 4) || (iFEMB <1)){
@@ -161,7 +545,7 @@ uint32_t WIBBase::ReadFEMB(int iFEMB,uint16_t address){
   return FEMB[iFEMB-1]->Read(address);    
   usleep((useconds_t) FEMBReadSleepTime * 1e6);
 }
-uint32_t WIBBase::ReadFEMB(int iFEMB,std::string const & address){
+uint32_t WIBBase::ReadFEMB(int iFEMB,std::string_view address){
   if((iFEMB > 4) || (iFEMB <1)){
     BUException::WIB_INDEX_OUT_OF_RANGE e;
     e.Append("In WIBBase::ReadFEMB\n");
@@ -170,6 +554,22 @@ uint32_t WIBBase::ReadFEMB(int iFEMB,std::string const & address){
   return FEMB[iFEMB-1]->Read(address);    
   usleep((useconds_t) FEMBReadSleepTime * 1e6);
 }
+uint32_t WIBBase::ReadFEMB(int iFEMB,RegisterHandle const & handle){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::ReadFEMB\n");
+    throw e;
+  }
+  return FEMB[iFEMB-1]->Read(handle);
+}
+std::vector<uint32_t> WIBBase::ReadFEMB(int iFEMB,std::vector<uint16_t> const & addresses){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::ReadFEMB\n");
+    throw e;
+  }
+  return FEMB[iFEMB-1]->ReadWithRetry(addresses);    
+}
 
 void WIBBase::WriteFEMB(int iFEMB,uint16_t address,uint32_t value){
   if((iFEMB > 4) || (iFEMB <1)){
@@ -180,7 +580,7 @@ void WIBBase::WriteFEMB(int iFEMB,uint16_t address,uint32_t value){
   FEMB[iFEMB-1]->WriteWithRetry(address,value);    
   usleep((useconds_t) FEMBWriteSleepTime * 1e6);
 }
-void WIBBase::WriteFEMB(int iFEMB,std::string const & address,uint32_t value){
+void WIBBase::WriteFEMB(int iFEMB,std::string_view address,uint32_t value){
   if((iFEMB > 4) || (iFEMB <1)){
     BUException::WIB_INDEX_OUT_OF_RANGE e;
     e.Append("In WIBBase::WriteFEMB\n");
@@ -189,6 +589,25 @@ void WIBBase::WriteFEMB(int iFEMB,std::string const & address,uint32_t value){
   FEMB[iFEMB-1]->WriteWithRetry(address,value);    
   usleep((useconds_t) FEMBWriteSleepTime * 1e6);
 }
+void WIBBase::WriteFEMB(int iFEMB,RegisterHandle const & handle,uint32_t value){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::WriteFEMB\n");
+    throw e;
+  }
+  FEMB[iFEMB-1]->WriteWithRetry(handle,value);    
+  usleep((useconds_t) FEMBWriteSleepTime * 1e6);
+}
+void WIBBase::WriteFEMB(int iFEMB,uint16_t address,std::vector<uint32_t> const & values){
+  if((iFEMB > 4) || (iFEMB <1)){
+    BUException::WIB_INDEX_OUT_OF_RANGE e;
+    e.Append("In WIBBase::WriteFEMB\n");
+    throw e;
+  }
+  //Consecutive registers starting at address, sent as block writes
+  FEMB[iFEMB-1]->Write(address,values);    
+  usleep((useconds_t) FEMBWriteSleepTime * 1e6);
+}
 
 void WIBBase::WriteFEMBBits(int iFEMB, uint16_t address, uint32_t pos, uint32_t mask, uint32_t value){
   if((iFEMB > 4) || (iFEMB <1)){
@@ -1,6 +1,7 @@
 #include "wibmod/WIB1/WIB.hh"
 #include "wibmod/Issues.hpp"
 #include "wibmod/WIB1/WIBException.hh"
+#include "wibmod/WIB1/Registers.hh"
 #include "ers/ers.hpp"
 
 #include <unistd.h>
@@ -8,19 +9,40 @@
 #include <stdio.h>
 #include <chrono>
 
+//A phase that hasn't reached W_PHASE after this long is abandoned and a new one tried
+#define PDTS_PHASE_WINDOW_US 500000
+//Clock settling time after the SI5344 soft reset, before the PDTS is enabled again
+#define PDTS_RESET_SETTLE_US 500000
+
+static char const * const PDTSStates[] = {"W_RST",
+					  "W_LINK",
+					  "W_FREQ",
+					  "W_ADJUST",
+					  "W_ALIGN",
+					  "W_LOCK",
+					  "W_PHASE",
+					  "W_RDY",
+					  "RUN",
+					  "0x9",
+					  "0xA",
+					  "0xB",
+					  "ERR_R",
+					  "ERR_T",
+					  "ERR_P",
+					  "0xF"};
 
 void WIB::InitializeDTS(uint8_t PDTSsource,uint8_t clockSource, uint32_t PDTSAlignment_timeout){
   //Disable the PDTS
-  WriteWithRetry("DTS.PDTS_ENABLE",0x0);
+  WriteWithRetry<regs::DTS::PDTS_ENABLE>(0x0);
 
   //Disable SI5344 outputs (fixed by SI5344 config)
-  WriteWithRetry("DTS.SI5344.ENABLE",0);
+  WriteWithRetry<regs::DTS::SI5344::ENABLE>(0);
   //Disable SI5344 (fixed by SI5344 config)
-  WriteWithRetry("DTS.SI5344.RESET",1);
+  WriteWithRetry<regs::DTS::SI5344::RESET>(1);
 
 
   //Reset the I2C firmware
-  WriteWithRetry("DTS.CDS.I2C.RESET",1);
+  WriteWithRetry<regs::DTS::CDS::I2C::RESET>(1);
 
   
   if(0 == clockSource){
@@ -34,8 +56,8 @@ void WIB::InitializeDTS(uint8_t PDTSsource,uint8_t clockSource, uint32_t PDTSAli
       e.Append("Failed to communicate with the DTS CDS via I2C\n");
       throw;
     }
-    uint32_t LOL = Read("DTS.CDS.LOL");
-    uint32_t LOS = Read("DTS.CDS.LOS");    
+    uint32_t LOL = Read<regs::DTS::CDS::LOL>();
+    uint32_t LOS = Read<regs::DTS::CDS::LOS>();    
     printf("CDS frequency %f\n",frequency);
     printf("CDS LOL=%d LOS=%d\n",LOL,LOS);
   
@@ -55,16 +77,16 @@ void WIB::InitializeDTS(uint8_t PDTSsource,uint8_t clockSource, uint32_t PDTSAli
   printf("\nConfiguring SI5344.\n");
 
   //Set the SI5344 source
-  WriteWithRetry("DTS.SI5344.INPUT_SELECT",clockSource);
+  WriteWithRetry<regs::DTS::SI5344::INPUT_SELECT>(clockSource);
   //Configure Si5344 with default config file
   //Do the I2C configuration
   try{
     LoadConfigDTS_SI5344(""); 
   }catch(BUException::exBase & e){
     //Disable SI5344 outputs
-    WriteWithRetry("DTS.SI5344.ENABLE",0);
+    WriteWithRetry<regs::DTS::SI5344::ENABLE>(0);
     //Disable SI5344
-    WriteWithRetry("DTS.SI5344.RESET",1);	
+    WriteWithRetry<regs::DTS::SI5344::RESET>(1);	
     
     e.Append("Error in LoadConfigDTS_SI5344\n");
     throw;
@@ -73,12 +95,12 @@ void WIB::InitializeDTS(uint8_t PDTSsource,uint8_t clockSource, uint32_t PDTSAli
   usleep(100000);
     
   //Check that SI5344 is locked on
-  if(ReadWithRetry("DTS.SI5344.LOS") ||
-     ReadWithRetry("DTS.SI5344.LOL")){
+  if(ReadWithRetry<regs::DTS::SI5344::LOS>() ||
+     ReadWithRetry<regs::DTS::SI5344::LOL>()){
     //Disable SI5344 outputs
-    WriteWithRetry("DTS.SI5344.ENABLE",0);
+    WriteWithRetry<regs::DTS::SI5344::ENABLE>(0);
     //Disable SI5344
-    WriteWithRetry("DTS.SI5344.RESET",1);	
+    WriteWithRetry<regs::DTS::SI5344::RESET>(1);	
     
     //Throw
     BUException::WIB_DTS_ERROR e;
@@ -87,87 +109,88 @@ void WIB::InitializeDTS(uint8_t PDTSsource,uint8_t clockSource, uint32_t PDTSAli
   }
 
   //Enable the clock for FPGA
-  WriteWithRetry("DTS.SI5344.ENABLE",1);
+  WriteWithRetry<regs::DTS::SI5344::ENABLE>(1);
   usleep(100000);
 
-  char const * const PDTSStates[] = {"W_RST",
-				     "W_LINK",
-				     "W_FREQ",
-				     "W_ADJUST",
-				     "W_ALIGN",
-				     "W_LOCK",
-				     "W_PHASE",
-				     "W_RDY",
-				     "RUN",
-				     "0x9",
-				     "0xA",
-				     "0xB",
-				     "ERR_R",
-				     "ERR_T",
-				     "ERR_P",
-				     "0xF"};
-
-  
   if(0 == clockSource){
     printf("\nSetup PDTS.\n");
-    bool timeout_exists = true;
-    if (PDTSAlignment_timeout == 0)
-	timeout_exists = false;
-
-    auto start_time = std::chrono::high_resolution_clock::now();
-    bool timed_out = false;
-
-    while ((timeout_exists == false) || timed_out == false) {
-      //Using PDTS, set that up.
-      usleep(500000);
-      WriteWithRetry("DTS.PDTS_ENABLE",1);
-      usleep(500000); //needed in new PDTS system to get to a good state before giving up and trying a new phase. 
-
-      //See if we've locked
-      uint32_t pdts_state = ReadWithRetry("DTS.PDTS_STATE");
-      printf("PDTS state: %s (0x%01X)\n",PDTSStates[pdts_state&0xF],pdts_state);
-      if ((pdts_state < 0x6) || (pdts_state > 0x8)) {
-          WriteWithRetry("DTS.PDTS_ENABLE",0);
-          //dynamic post-amble
-          Write("DTS.SI5344.I2C.RESET",1);
-          SetDTS_SI5344Page(0x0);
-          Write("DTS.SI5344.I2C.RESET",1);
-          WriteDTS_SI5344(0x1C,0x1,1);
+    AcquirePDTSLock(PDTSAlignment_timeout);
+  }
+}
+
+void WIB::SetPDTSPollInterval(uint32_t us){
+  PDTSPollInterval = us;
+}
+
+void WIB::SoftResetDTS_SI5344(){
+  //dynamic post-amble
+  Write<regs::DTS::SI5344::I2C::RESET>(1);
+  SetDTS_SI5344Page(0x0);
+  Write<regs::DTS::SI5344::I2C::RESET>(1);
+  WriteDTS_SI5344(0x1C,0x1,1);
+}
+
+void WIB::AcquirePDTSLock(uint32_t timeout_ms){
+  typedef std::chrono::steady_clock clock;
+  clock::time_point start = clock::now();
+  clock::time_point deadline = start + std::chrono::milliseconds(timeout_ms);
+  PDTSTimeline.clear();
+
+  for(uint32_t attempt = 1;;attempt++){
+    //Try a new phase
+    WriteWithRetry<regs::DTS::PDTS_ENABLE>(1);
+    clock::time_point attemptStart = clock::now();
+    int lastState = -1;
+    while(true){
+      uint8_t pdts_state = ReadWithRetry<regs::DTS::PDTS_STATE>() & 0xF;
+      clock::time_point now = clock::now();
+      if(pdts_state != lastState){
+	PDTSTransition transition = {std::chrono::duration<double>(now - start).count(),pdts_state};
+	PDTSTimeline.push_back(transition);
+	printf("PDTS state: %s (0x%01X) at %.1f ms\n",PDTSStates[pdts_state],pdts_state,1000*transition.time);
+	if(0x6 == pdts_state){
+	  ers::info(dunedaq::wibmod::WaitingForAlignment(ERS_HERE));
+	}else if(0x7 == pdts_state){
+	  ers::info(dunedaq::wibmod::WaitingForTimestamp(ERS_HERE));
+	}
+	lastState = pdts_state;
       }
-      else if(0x6 == pdts_state){
-          ers::info(dunedaq::wibmod::WaitingForAlignment(ERS_HERE));
+      if(0x8 == pdts_state){
+	printf("PDTS in RUN after %.1f ms (attempt %u)\n",
+	       1000*std::chrono::duration<double>(now - start).count(),attempt);
+	return;
       }
-      else if(0x7 == pdts_state){
-          ers::info(dunedaq::wibmod::WaitingForTimestamp(ERS_HERE));
+      if((timeout_ms != 0) && (now >= deadline)){
+	//If we get here something went wrong
+	SoftResetDTS_SI5344();
+	BUException::WIB_DTS_ERROR e;
+	char info[96];
+	snprintf(info,sizeof(info),"Failed to configure the PDTS correctly within %u ms (state %s after %u attempts)\n",
+		 timeout_ms,PDTSStates[pdts_state],attempt);
+	e.Append(info);
+	throw e;
       }
-      else {
-          return; //0x8 == pdts_state
+      //An error state gives up on this phase at once, the early states get a window to reach W_PHASE
+      if((pdts_state > 0x8) ||
+	 ((pdts_state < 0x6) && (now - attemptStart >= std::chrono::microseconds(PDTS_PHASE_WINDOW_US)))){
+	break;
       }
-      auto now = std::chrono::high_resolution_clock::now();
-      auto duration = now - start_time;
-      if ( duration.count() > PDTSAlignment_timeout)
-          timed_out = true;
+      usleep(PDTSPollInterval);
     }
-    //If we get here something went wrong
-    Write("DTS.SI5344.I2C.RESET",1);
-    SetDTS_SI5344Page(0x0);
-    Write("DTS.SI5344.I2C.RESET",1);
-    WriteDTS_SI5344(0x1C,0x1,1);
-
-    BUException::WIB_DTS_ERROR e;
-    e.Append("Failed to configure the PDTS correctly within timeout\n");
-    throw e; 
+    WriteWithRetry<regs::DTS::PDTS_ENABLE>(0);
+    SoftResetDTS_SI5344();
+    usleep(PDTS_RESET_SETTLE_US);
   }
 }
 
 void WIB::StartSyncDTS(){
-  WriteWithRetry("DTS.CONVERT_CONTROL.HALT",0);
-  WriteWithRetry("DTS.CONVERT_CONTROL.ENABLE",1);
-  WriteWithRetry("DTS.CONVERT_CONTROL.START_SYNC",1);
+  WriteWithRetry<regs::DTS::CONVERT_CONTROL::HALT>(0);
+  WriteWithRetry<regs::DTS::CONVERT_CONTROL::ENABLE>(1);
+  WriteWithRetry<regs::DTS::CONVERT_CONTROL::START_SYNC>(1);
 }
 
 void WIB::PDTSInRunningState(){
-  if(Read("DTS.PDTS_STATE") != 0x8){
+  if(Read<regs::DTS::PDTS_STATE>() != 0x8){
     BUException::WIB_DTS_ERROR e;
     e.Append("WIB is not in PDTS state RUN(0x8)\n");
     throw e;
@@ -111,6 +111,7 @@ void WIB::ConfigFEMB(uint8_t iFEMB, std::vector<uint32_t> fe_config, std::vector
   }
 
   WriteFEMB(iFEMB, "REG_RESET", 1);
+  InvalidateFEMBShadowRegisters(iFEMB);
   sleep(1);
 
   WriteFEMB(iFEMB, "START_FRAME_MODE_SELECT", start_frame_mode_sel);
@@ -325,6 +326,7 @@ void WIB::ConfigFEMBFakeData(uint8_t iFEMB, uint8_t fake_mode, uint32_t fake_wor
   Write("SYSTEM.SLOW_CONTROL_DND",1);
 
   WriteFEMB(iFEMB, "REG_RESET", 1);
+  InvalidateFEMBShadowRegisters(iFEMB);
   sleep(1);
 
   WriteFEMB(iFEMB, "STREAM_AND_ADC_DATA_EN", 0);
@@ -347,11 +349,7 @@ void WIB::ConfigFEMBFakeData(uint8_t iFEMB, uint8_t fake_mode, uint32_t fake_wor
   if (fake_mode == 2)
   {
     // Put waveform in FEMB registers
-    for (size_t iSample=0; iSample < 256; iSample++)
-    {
-      WriteFEMB(iFEMB,0x300+iSample,fake_samples.at(iSample));
-      sleep(0.005);
-    }
+    WriteFEMB(iFEMB,0x300,fake_samples);
   }
   if (fake_mode == 3)
   {
@@ -568,10 +566,7 @@ uint16_t WIB::SetupFEMBASICs(uint8_t iFEMB, std::vector<uint32_t> registerList){
   WriteFEMB(iFEMB, "STREAM_EN", 0 );
   sleep(2);
 
-  for (size_t iReg=0; iReg < NREGS; iReg++)
-  {
-    WriteFEMB(iFEMB, REG_SPI_BASE + iReg, registerList[iReg]);
-  }
+  WriteFEMB(iFEMB, REG_SPI_BASE, registerList);
 
   /////////////////////////////
   //run the SPI programming
@@ -723,11 +718,7 @@ uint16_t WIB::SetupFEMBASICs(uint8_t iFEMB, uint8_t gain, uint8_t shape, uint8_t
     sleep(0.1);
   
     std::cout << "ASIC SPI Write Registers..." << std::endl;
-    for (size_t iReg=0; iReg<nRegs; iReg++)
-    {
-        WriteFEMB(iFEMB,REG_SPI_BASE_WRITE+iReg,regs[iReg]);
-        sleep(0.01);
-    }
+    WriteFEMB(iFEMB,REG_SPI_BASE_WRITE,regs);
   
   
     //run the SPI programming
@@ -742,13 +733,12 @@ uint16_t WIB::SetupFEMBASICs(uint8_t iFEMB, uint8_t gain, uint8_t shape, uint8_t
       for (unsigned iSPIRead = 0; iSPIRead < 2; iSPIRead++)
       {
         std::cout << "ASIC SPI Readback..." << std::endl;
-        std::vector<uint32_t> regsReadback(nRegs);
+        std::vector<uint16_t> readbackAddresses(nRegs);
         for (size_t iReg=0; iReg<nRegs; iReg++)
         {
-            uint32_t regReadback = ReadFEMB(iFEMB,REG_SPI_BASE_READ+iReg);
-            regsReadback[iReg] = regReadback;
-            sleep(0.01);
+            readbackAddresses[iReg] = REG_SPI_BASE_READ+iReg;
         }
+        std::vector<uint32_t> regsReadback = ReadFEMB(iFEMB,readbackAddresses);
   
         bool verbose = false;
         if (verbose) std::cout << "ASIC SPI register number, write val, read val:" << std::endl;
@@ -858,13 +848,12 @@ uint16_t WIB::SetupASICPulserBits(uint8_t iFEMB){
       for (unsigned iSPIRead = 0; iSPIRead < 2; iSPIRead++)
       {
         std::cout << "ASIC SPI Readback..." << std::endl;
-        std::vector<uint32_t> regsReadback(nASICs);
+        std::vector<uint16_t> readbackAddresses(nASICs);
         for (size_t iASIC=0; iASIC<nASICs; iASIC++)
         {
-            uint32_t regReadback = ReadFEMB(iFEMB, (REG_SPI_BASE_READ + 9*iASIC + 8));
-            regsReadback[iASIC] = regReadback;
-            sleep(0.01);
+            readbackAddresses[iASIC] = REG_SPI_BASE_READ + 9*iASIC + 8;
         }
+        std::vector<uint32_t> regsReadback = ReadFEMB(iFEMB,readbackAddresses);
   
         std::cout << "ASIC SPI register number, write val, read val:" << std::endl;
         spi_mismatch = false;
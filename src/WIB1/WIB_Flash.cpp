@@ -152,6 +152,10 @@ void WIB::ReadFlash(std::string const & fileName,uint8_t update_percentage){
   
   uint32_t blockRegMapAddress = GetItem("FLASH.DATA00")->address;
   size_t blockSize = 64;
+  std::vector<uint16_t> blockAddresses(blockSize);
+  for(size_t iWordRead = 0;iWordRead < blockSize;iWordRead++){
+    blockAddresses[iWordRead] = blockRegMapAddress+iWordRead;
+  }
   //set block size
   WriteWithRetry("FLASH.BYTE_COUNT",255);
 
@@ -166,8 +170,9 @@ void WIB::ReadFlash(std::string const & fileName,uint8_t update_percentage){
     FlashCheckBusy();
     
     //Readout the data
+    std::vector<uint32_t> blockData = ReadWithRetry(blockAddresses);
     for(size_t iWordRead = 0;iWordRead < blockSize;iWordRead++){
-      fprintf(outFile,"0x%06X 0x%08X\n",uint32_t(iWord),ReadWithRetry(blockRegMapAddress+iWordRead));
+      fprintf(outFile,"0x%06X 0x%08X\n",uint32_t(iWord),blockData[iWordRead]);
       iWord++;
     }
 
@@ -266,11 +271,18 @@ void WIB::WriteFlash(std::vector<uint32_t> flashData,uint8_t update_percentage){
     WriteWithRetry("FLASH.BYTE_COUNT",(blockSize*sizeof(uint32_t))-1); 
 
     //Write block of data
-    for(size_t iBlockWord = 0; iBlockWord < blockSize;iBlockWord++){
-      //arg1: Address in WIB register map of this 32bit word
-      //arg2: Data for this 32bit word reg map address in data vector
-      WriteWithRetry(blockRegMapAddress               + iBlockWord,   
-		     flashData[currentBlockStartIndex + iBlockWord]); 
+    //arg1: Address in WIB register map of the first 32bit word
+    //arg2: Data for these reg map addresses in data vector
+    try{
+      Write(blockRegMapAddress,
+	    &flashData[currentBlockStartIndex],
+	    blockSize);
+    }catch(BUException::BAD_REPLY & e){
+      //Part of the block wasn't acknowledged.  The data registers are only used by RUN_COMMAND,
+      //so write the whole block again a word at a time (with retries) before starting it.
+      for(size_t iWord = 0; iWord < blockSize;iWord++){
+	WriteWithRetry(uint16_t(blockRegMapAddress+iWord),flashData[currentBlockStartIndex+iWord]);
+      }
     }
     //Do the block write
     WriteWithRetry("FLASH.RUN_COMMAND",0x1);
@@ -326,11 +338,16 @@ void WIB::CheckFlash(std::vector<uint32_t> flashData,uint8_t update_percentage){
     FlashCheckBusy();
 
     //Check the data.
+    std::vector<uint16_t> blockAddresses(blockSize);
+    for(size_t iBlockWord = 0;iBlockWord < blockSize;iBlockWord++){
+      blockAddresses[iBlockWord] = blockRegMapAddress + iBlockWord;
+    }
+    //ReadWithRetry: Data from the flash for this block
+    std::vector<uint32_t> blockData = ReadWithRetry(blockAddresses);
     for(size_t iBlockWord = 0;iBlockWord < blockSize;iBlockWord++){
       //flashData:     Address in WIB register map of this 32bit word
-      //ReadWithRetry: Data from the flash for this word
       uint32_t dataRead;
-      if((dataRead = ReadWithRetry(blockRegMapAddress + iBlockWord)) !=
+      if((dataRead = blockData[iBlockWord]) !=
 	 flashData[currentBlockStartIndex + iBlockWord]){
 	BUException::WIB_FLASH_ERROR e;	
 	char errorbuffer[] = "Error on index 0xXXXXXXXX: 0xXXXXXXXX != 0xXXXXXXXX";
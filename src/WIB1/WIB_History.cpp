@@ -3,7 +3,8 @@
 std::vector<uint32_t> WIB::CaptureHistory(std::string const & address){
   std::vector<uint32_t> ret;
   uint32_t val;
-  while( (val = Read(address)) & 0x1){
+  RegisterHandle const history = Resolve(address);
+  while( (val = Read(history)) & 0x1){
     ret.push_back(val);
   }
   return ret;
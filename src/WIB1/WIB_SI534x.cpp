@@ -0,0 +1,189 @@
+#include "wibmod/WIB1/WIB.hh"
+#include "wibmod/WIB1/WIBException.hh"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unistd.h> //usleep
+
+//ClockBuilder Pro register scripts for the SI534x chips: "address,data" lines (16bit paged address)
+//with a preamble, a 300ms wait, the configuration registers and a postamble marked by comments.
+struct SI534xConfig{
+  std::vector<WIBBase::I2CPagedWrite> preamble;
+  std::vector<WIBBase::I2CPagedWrite> body;
+  std::vector<WIBBase::I2CPagedWrite> postamble;
+};
+
+static void read_si534x_config(std::istream & confFile, SI534xConfig & config){
+  std::vector<WIBBase::I2CPagedWrite> writes;
+  size_t preambleEnd = std::string::npos;
+  size_t postambleStart = std::string::npos;
+  while(!confFile.eof()){
+    std::string line;
+    std::getline(confFile,line);
+    if(line.size() == 0){
+      continue;
+    }else if(line[0] == '#'){
+      if(line.find("End configuration preamble") != std::string::npos){
+	preambleEnd = writes.size();
+      }else if(line.find("Start configuration postamble") != std::string::npos){
+	postambleStart = writes.size();
+      }
+      continue;
+    }else if(line[0] == 'A'){
+      continue;
+    }else{
+      if( line.find(',') == std::string::npos ){
+	printf("Skipping bad line: \"%s\"\n",line.c_str());
+	continue;
+      }
+      uint16_t address = strtoul(line.substr(0,line.find(',')).c_str(),NULL,16);
+      uint8_t  data    = strtoul(line.substr(line.find(',')+1).c_str(),NULL,16);
+      WIBBase::I2CPagedWrite write = {uint8_t((address >> 8)&0xFF),uint8_t(address&0xFF),data};
+      writes.push_back(write);
+    }
+  }
+  //Files without the markers: the first three writes are the preamble, as ClockBuilder writes them
+  if(preambleEnd == std::string::npos){
+    preambleEnd = std::min(writes.size(),size_t(3));
+  }
+  if(postambleStart == std::string::npos || postambleStart < preambleEnd){
+    postambleStart = writes.size();
+  }
+  config.preamble.assign(writes.begin(),writes.begin()+preambleEnd);
+  config.body.assign(writes.begin()+preambleEnd,writes.begin()+postambleStart);
+  config.postamble.assign(writes.begin()+postambleStart,writes.end());
+}
+
+//Compiled scripts, keyed by the 64bit FNV-1a hash of their text, so an edited file is compiled again
+static std::mutex si534xCacheMutex;
+static std::map<uint64_t,std::shared_ptr<SI534xConfig const> > si534xCache;
+
+static std::shared_ptr<SI534xConfig const> get_si534x_config(std::ifstream & confFile){
+  std::string text((std::istreambuf_iterator<char>(confFile)),std::istreambuf_iterator<char>());
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for(size_t iChar = 0; iChar < text.size();iChar++){
+    hash ^= uint8_t(text[iChar]);
+    hash *= 0x100000001b3ULL;
+  }
+  std::lock_guard<std::mutex> lock(si534xCacheMutex);
+  std::shared_ptr<SI534xConfig const> & config = si534xCache[hash];
+  if(!config){
+    std::shared_ptr<SI534xConfig> compiled(new SI534xConfig);
+    std::istringstream textStream(text);
+    read_si534x_config(textStream,*compiled);
+    config = compiled;
+  }
+  return config;
+}
+
+//The configuration registers whose value on the chip (in current) isn't the script's.  A register the
+//script writes more than once is compared against its last value and, if different, written in full.
+static std::vector<WIBBase::I2CPagedWrite> si534x_differences(std::vector<WIBBase::I2CPagedWrite> const & body,
+							      std::vector<WIBBase::I2CPagedWrite> const & current){
+  std::map<uint16_t,bool> differs;
+  for(size_t iWrite = 0; iWrite < body.size();iWrite++){
+    //Later writes overwrite earlier ones
+    differs[(uint16_t(body[iWrite].page) << 8) | body[iWrite].address] = (body[iWrite].data != current[iWrite].data);
+  }
+  std::vector<WIBBase::I2CPagedWrite> writes;
+  for(size_t iWrite = 0; iWrite < body.size();iWrite++){
+    if(differs[(uint16_t(body[iWrite].page) << 8) | body[iWrite].address]){
+      writes.push_back(body[iWrite]);
+    }
+  }
+  return writes;
+}
+
+bool WIB::LoadConfigSI534x(std::string const & chip, std::string const & fileName, char const * defaultFileName){
+  std::string chipName = chip.substr(chip.rfind('.')+1);
+  std::ifstream confFile(fileName.c_str());
+  BUException::WIB_BAD_ARGS badFile;
+
+  if(confFile.fail()){
+    //Failed to topen filename, add it to the exception
+    badFile.Append(("Bad "+chipName+" config file name:").c_str());
+    badFile.Append(fileName.c_str());
+
+    //Try the default
+    if(getenv("WIBMOD_SHARE") != NULL){
+      std::string envBasedFileName=getenv("WIBMOD_SHARE");
+      envBasedFileName+="/config/WIB1/config/";
+      envBasedFileName+=defaultFileName;
+      confFile.open(envBasedFileName.c_str());
+      if(confFile.fail()){
+	badFile.Append("Bad env based filename:");
+	badFile.Append(envBasedFileName.c_str());
+      }
+    }
+  }
+
+  if(confFile.fail()){
+    //We are still failing to open our file
+    throw badFile;
+  }
+
+  std::shared_ptr<SI534xConfig const> config = get_si534x_config(confFile);
+
+  //Make sure the chip isn't in reset
+  if(Read(chip+".RESET") != 0){
+    Write(chip+".RESET",0x0);
+    usleep(50000);
+  }
+
+  //Reset the I2C firmware
+  Write(chip+".I2C.RESET",1);
+
+  //Only the configuration registers the chip doesn't already hold need writing
+  std::string i2c = chip+".I2C";
+  std::vector<I2CPagedWrite> body;
+  try{
+    //One byte per read: a register paired with its neighbour's value could compare equal and be skipped
+    std::vector<I2CPagedWrite> current(config->body);
+    ReadI2CBurst(i2c,current,0x01,1);
+    body = si534x_differences(config->body,current);
+  }catch(BUException::exBase & e){
+    printf("Can't read back the %s configuration, writing all of it\n",chipName.c_str());
+    Write(chip+".I2C.RESET",1);
+    body = config->body;
+  }
+  if(body.empty()){
+    printf("%s already holds this configuration\n",chipName.c_str());
+    return false;
+  }
+
+  //Disable the output
+  Write(chip+".ENABLE",0x0);
+
+  //The preamble and postamble are order dependent, the configuration registers can go page by page
+  std::vector<size_t> failed[3];
+  failed[0] = WriteI2CBurst(i2c,config->preamble,true);
+  //Wait for any calibration running due to the preamble's state change
+  usleep(300000);
+  failed[1] = WriteI2CBurst(i2c,body);
+  failed[2] = WriteI2CBurst(i2c,config->postamble,true);
+
+  std::vector<I2CPagedWrite> const * sections[3] = {&config->preamble,&body,&config->postamble};
+  size_t failedCount = failed[0].size() + failed[1].size() + failed[2].size();
+  printf("Wrote %zu %s registers (%zu of %zu configuration registers differed)\n",
+	 config->preamble.size() + body.size() + config->postamble.size() - failedCount,chipName.c_str(),
+	 body.size(),config->body.size());
+  if(failedCount != 0){
+    BUException::WIB_ERROR e;
+    char info[64];
+    snprintf(info,sizeof(info),"%zu %s register writes failed after 10 tries:",failedCount,chipName.c_str());
+    e.Append(info);
+    for(size_t iSection = 0; iSection < 3;iSection++){
+      for(size_t iFailed = 0; iFailed < failed[iSection].size();iFailed++){
+	I2CPagedWrite const & write = (*sections[iSection])[failed[iSection][iFailed]];
+	snprintf(info,sizeof(info)," 0x%02X%02X",write.page,write.address);
+	e.Append(info);
+      }
+    }
+    e.Append("\n");
+    throw e;
+  }
+  return true;
+}
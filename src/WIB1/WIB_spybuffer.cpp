@@ -8,9 +8,11 @@ std::vector<data_8b10b_t> WIB::ReadOutCDLinkSpyBuffer(){
     throw e;      
   }
   
+  RegisterHandle const fifoEmpty = Resolve("FEMB_SPY.FIFO_EMPTY");
+  RegisterHandle const fifoData  = Resolve("FEMB_SPY.DATA");
   std::vector<data_8b10b_t> data;
-  while(!Read("FEMB_SPY.FIFO_EMPTY")){
-    uint32_t val = Read("FEMB_SPY.DATA");
+  while(!Read(fifoEmpty)){
+    uint32_t val = Read(fifoData);
     data.push_back( data_8b10b_t((val>>8)&0x1,uint8_t(val&0xff)));
   }
   return data;
@@ -22,18 +24,23 @@ std::vector<data_8b10b_t> WIB::ReadDAQLinkSpyBuffer(uint8_t iDAQLink,uint8_t tri
   std::string base("DAQ_LINK_");
   base.push_back(GetDAQLinkChar(iDAQLink));
   base.append(".SPY_BUFFER.");
+  //Resolve the names once, the read out loops below run once per word
+  RegisterHandle const capturing   = Resolve(base+"CAPTURING_DATA");
+  RegisterHandle const empty       = Resolve(base+"EMPTY");
+  RegisterHandle const data_word   = Resolve(base+"DATA");
+  RegisterHandle const k_data_word = Resolve(base+"K_DATA");
 
   //Check if there is an active capture
-  if(ReadWithRetry(base+"CAPTURING_DATA")){
+  if(ReadWithRetry(capturing)){
     BUException::WIB_BUSY e;
     e.Append(base);
     e.Append(" is busy\n");
     throw e;
   }
   //The spy buffer isn't busy, so let's make sure the fifo is empty
-  while(!ReadWithRetry(base+"EMPTY")){
+  while(!ReadWithRetry(empty)){
     //Read out a workd from the fifo
-    WriteWithRetry(base+"DATA",0x0);
+    WriteWithRetry(data_word,0x0);
   }
   
   //write trigger mode
@@ -43,17 +50,17 @@ std::vector<data_8b10b_t> WIB::ReadDAQLinkSpyBuffer(uint8_t iDAQLink,uint8_t tri
   Write(base+"START",0x1);
 
   //Wait for capture to finish
-  while(ReadWithRetry(base+"CAPTURING_DATA")){
+  while(ReadWithRetry(capturing)){
   }
 
   //Read out the data
   std::vector<data_8b10b_t> ret;
   
-  while(!ReadWithRetry(base+"EMPTY")){
+  while(!ReadWithRetry(empty)){
     //read out the k-chars
-    uint32_t k_data = ReadWithRetry(base+"K_DATA");
+    uint32_t k_data = ReadWithRetry(k_data_word);
     //read out the data
-    uint32_t data = ReadWithRetry(base+"DATA");
+    uint32_t data = ReadWithRetry(data_word);
 
     //    printf("0x%08X 0x%08X\n",k_data,data);
 
@@ -62,7 +69,7 @@ std::vector<data_8b10b_t> WIB::ReadDAQLinkSpyBuffer(uint8_t iDAQLink,uint8_t tri
 				  (data >>(iWord*8) &0xFF)));
     }   
     //mark word as read
-    Write(base+"DATA",0x0);
+    Write(data_word,0x0);
   }
   return ret;
 }
@@ -0,0 +1,99 @@
+#include "wibmod/WIB1/WriteBatch.hh"
+#include "wibmod/WIB1/AddressTableException.hh"
+
+WriteBatch::WriteBatch(AddressTable * _table){
+  if(_table == NULL){
+    BUException::INVALID_NAME e;
+    e.Append("WriteBatch needs an address table");
+    throw e;
+  }
+  table = _table;
+}
+
+WriteBatch & WriteBatch::Write(std::string_view registerName,uint32_t val){
+  return Write(table->Resolve(registerName),val);
+}
+
+WriteBatch & WriteBatch::Write(RegisterHandle const & handle,uint32_t val){
+  table->CheckHandle(handle);
+  uint32_t value = handle.mask & (val << handle.offset);
+  uint32_t action = (handle.mode & Item::ACTION) ? handle.mask : 0;
+
+  //Merge into the latest write of this register unless it already has these bits
+  for(size_t iEntry = entries.size(); iEntry > 0;iEntry--){
+    Entry & entry = entries[iEntry-1];
+    if(entry.address != handle.address){
+      continue;
+    }
+    if((entry.mask & handle.mask) == 0){
+      entry.mask   |= handle.mask;
+      entry.value  |= value;
+      entry.action |= action;
+      return *this;
+    }
+    break;
+  }
+  Entry entry = {handle.address,handle.mask,value,action};
+  entries.push_back(entry);
+  return *this;
+}
+
+void WriteBatch::Commit(bool retry){
+  if(entries.empty()){
+    return;
+  }
+
+  //Current value of every register staged with only some of its bits
+  boost::unordered_map<uint16_t,uint32_t> current;
+  std::vector<uint16_t> readAddresses;
+  for(size_t iEntry = 0; iEntry < entries.size();iEntry++){
+    uint16_t address = entries[iEntry].address;
+    if(current.find(address) != current.end()){
+      continue;
+    }
+    current[address] = 0;
+    if(entries[iEntry].mask == 0xFFFFFFFF){
+      continue;
+    }
+    boost::unordered_map<uint16_t,uint32_t>::const_iterator itShadow = table->shadow.find(address);
+    if(table->shadowEnabled && itShadow != table->shadow.end()){
+      current[address] = itShadow->second;
+    }else{
+      readAddresses.push_back(address);
+    }
+  }
+  if(!readAddresses.empty()){
+    std::vector<uint32_t> values = retry ? table->ReadWithRetry(readAddresses) : table->Read(readAddresses);
+    for(size_t iRead = 0; iRead < readAddresses.size();iRead++){
+      current[readAddresses[iRead]] = values[iRead];
+    }
+  }
+
+  //Build every word in staging order
+  std::vector<uint32_t> words(entries.size());
+  for(size_t iEntry = 0; iEntry < entries.size();iEntry++){
+    Entry const & entry = entries[iEntry];
+    uint32_t & value = current[entry.address];
+    words[iEntry] = (value & ~entry.mask) | entry.value;
+    //What a later write of this register would have read back
+    value = words[iEntry] & ~entry.action;
+  }
+
+  //Send them, block writing runs of consecutive registers
+  size_t iEntry = 0;
+  while(iEntry < entries.size()){
+    size_t runLength = 1;
+    while(!retry &&
+	  (iEntry + runLength < entries.size()) &&
+	  (entries[iEntry + runLength].address == entries[iEntry].address + runLength)){
+      runLength++;
+    }
+    if(runLength == 1){
+      table->WriteWord(entries[iEntry].address,words[iEntry],retry);
+    }else{
+      table->Write(entries[iEntry].address,&words[iEntry],runLength);
+    }
+    iEntry += runLength;
+  }
+  entries.clear();
+}
@@ -7,8 +7,13 @@
 
 
 #include "wibmod/WIB1/ItemConversion.hh"
+#include "wibmod/WIB1/ParsedAddressTable.hh"
 
 #include <stdio.h> // sscanf
+#include <string.h> // memcpy
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <boost/foreach.hpp>
 
 using boost::unordered_map;
@@ -66,3 +71,81 @@ ItemConversion * ItemConversion::FromString(std::string convstring) {
   return NULL;
 }
 
+ItemConversion * ItemConversion::Get(std::string const & convstring) {
+  // never freed: items of every table point here for the life of the process
+  static std::mutex registryLock;
+  static unordered_map<std::string, ItemConversion *> registry;
+  std::lock_guard<std::mutex> lock(registryLock);
+  unordered_map<std::string, ItemConversion *>::iterator it = registry.find(convstring);
+  if (it != registry.end()) {
+    return it->second;
+  }
+  ItemConversion *conv = FromString(convstring);
+  if (conv) {
+    registry[convstring] = conv;
+  }
+  return conv;
+}
+
+ItemConversionBatch::ItemConversionBatch(std::vector<Item const *> const & items) {
+  outputSize = 0;
+  offsets.resize(items.size());
+  for (size_t iItem = 0; iItem < items.size(); iItem++) {
+    ItemConversion *conv = items[iItem]->sc_conv;
+    offsets[iItem] = outputSize;
+    if (conv == NULL) {
+      // same as "pass"
+      pass.index.push_back(iItem);
+      pass.offset.push_back(outputSize);
+      outputSize += sizeof(uint32_t);
+      continue;
+    }
+    switch (conv->GetKind()) {
+    case ItemConversion::PASS:
+      pass.index.push_back(iItem);
+      pass.offset.push_back(outputSize);
+      break;
+    case ItemConversion::LINEAR:
+      linear.index.push_back(iItem);
+      linear.offset.push_back(outputSize);
+      linearScale.push_back(static_cast<itemconv::itemconv_linear *>(conv)->Scale());
+      linearOffset.push_back(static_cast<itemconv::itemconv_linear *>(conv)->Offset());
+      break;
+    case ItemConversion::ENUM:
+      enums.index.push_back(iItem);
+      enums.offset.push_back(outputSize);
+      enumConv.push_back(conv);
+      break;
+    default:
+      other.index.push_back(iItem);
+      other.offset.push_back(outputSize);
+      otherConv.push_back(conv);
+      break;
+    }
+    outputSize += conv->DataSize();
+  }
+}
+
+void ItemConversionBatch::Convert(uint32_t const * values, void * dest) const {
+  char *out = (char *)dest;
+  for (size_t i = 0; i < pass.index.size(); i++) {
+    memcpy(out + pass.offset[i], &values[pass.index[i]], sizeof(uint32_t));
+  }
+  for (size_t i = 0; i < linear.index.size(); i++) {
+    double val = ((double)values[linear.index[i]]) * linearScale[i] + linearOffset[i];
+    memcpy(out + linear.offset[i], &val, sizeof(val));
+  }
+  for (size_t i = 0; i < enums.index.size(); i++) {
+    itemconv::itemconv_enum *conv = static_cast<itemconv::itemconv_enum *>(enumConv[i]);
+    uint32_t src = values[enums.index[i]];
+    char const *name = conv->Lookup(src);
+    if (name) {
+      memcpy(out + enums.offset[i], name, conv->DataSize());
+    } else {
+      conv->itemconv::itemconv_enum::Convert(src, out + enums.offset[i]);
+    }
+  }
+  for (size_t i = 0; i < other.index.size(); i++) {
+    otherConv[i]->Convert(values[other.index[i]], out + other.offset[i]);
+  }
+}
@@ -2,43 +2,83 @@
 #define __ADDRESSTABLE_HPP__
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
 #include <boost/unordered_map.hpp>
-#include <map>
 
 #include <stdint.h>
 
-#include "wibmod/WIB1/ItemConversion.hh"
-#include "wibmod/WIB1/BNL_UDP.hh"
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+#include "wibmod/WIB1/Register.hh"
+#include "wibmod/WIB1/RegisterSnapshot.hh"
+#include "wibmod/WIB1/RegisterTransport.hh"
 
-class Item{
+class AddressTable;
+
+//A register name resolved once by AddressTable::Resolve, so repeated accesses skip the name lookup.
+//Copyable, valid for as long as the table that resolved it.
+class RegisterHandle{
 public:
-  enum ModeMask{EMPTY=0x0,READ = 0x1,WRITE =0x2, ACTION = 0x4};
-  std::string name;
+  RegisterHandle():table(NULL),address(0),mask(0),offset(0),mode(Item::EMPTY){};
+  bool Valid() const {return table != NULL;};
+  AddressTable * table;
   uint16_t address;
   uint32_t mask;
   uint8_t  offset;
-  uint8_t  mode; // r :0, w :1, a:2
-  boost::unordered_map<std::string,std::string> user;   
-  ItemConversion *sc_conv;
+  uint8_t  mode;
 };
 
 class AddressTable{
  public:
   AddressTable(std::string const & addressTableName, std::string const & deviceAddress,uint16_t offset);
+  ~AddressTable();
   uint32_t Read(uint16_t);
-  uint32_t Read(std::string registerName);
+  uint32_t Read(std::string_view registerName);
   uint32_t ReadWithRetry(uint16_t);
-  uint32_t ReadWithRetry(std::string registerName);
+  uint32_t ReadWithRetry(std::string_view registerName);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses);
   void Write(uint16_t, uint32_t);
-  void Write(std::string registerName,uint32_t val);
+  void Write(std::string_view registerName,uint32_t val);
   void WriteWithRetry(uint16_t, uint32_t);
-  void WriteWithRetry(std::string registerName,uint32_t val);
+  void WriteWithRetry(std::string_view registerName,uint32_t val);
   void Write(uint16_t, std::vector<uint32_t> const & values);
-  void Write(std::string registerName,std::vector<uint32_t> const & values);
+  void Write(std::string_view registerName,std::vector<uint32_t> const & values);
   void Write(uint16_t, uint32_t const * values, size_t word_count);
-  void Write(std::string registerName, uint32_t const * values, size_t word_count);
-  Item const * GetItem(std::string const &);
+  void Write(std::string_view registerName, uint32_t const * values, size_t word_count);
+  Item const * GetItem(std::string_view registerName);
+  RegisterHandle Resolve(std::string_view registerName);
+  uint32_t Read(RegisterHandle const & handle);
+  uint32_t ReadWithRetry(RegisterHandle const & handle);
+  void Write(RegisterHandle const & handle,uint32_t val);
+  void WriteWithRetry(RegisterHandle const & handle,uint32_t val);
+
+  //Typed access through the descriptors generated into wibmod/WIB1/Registers.hh,
+  //e.g. Read<regs::DTS::PDTS_STATE>().  If this table is the one they were generated from
+  //the address, mask and shift are compile-time constants, otherwise the name is looked up.
+  template<class REGISTER> RegisterHandle Resolve();
+  template<class REGISTER> uint32_t Read();
+  template<class REGISTER> uint32_t ReadWithRetry();
+  template<class REGISTER> void Write(uint32_t val);
+  template<class REGISTER> void WriteWithRetry(uint32_t val);
+
+  //Shadow registers: remember the last value written to or read from each register so a write
+  //to a field narrower than the register can skip its read (read-modify-write) round trip.
+  //Reads always go to the device.  Off by default; registers whose writable bits change on
+  //their own should be tagged "volatile" in the .adt, and the shadow must be invalidated
+  //after anything that resets the device's registers.
+  void EnableShadow(bool enable);
+  void InvalidateShadow();
+  void InvalidateShadow(uint16_t address);
+
+  //Read a set of fields with one bulk read of the registers behind them, e.g. Snapshot("DTS.SI5344").
+  //Snapshot takes the readable fields named prefix or below it ("" for all), SnapshotTagged the readable
+  //fields with a user field/flag (e.g. "slowcontrol"), SnapshotNames the given fields (INVALID_NAME if unknown)
+  RegisterSnapshot Snapshot(std::string const & prefix, bool retry = false);
+  RegisterSnapshot SnapshotTagged(std::string const & tag, bool retry = false);
+  RegisterSnapshot SnapshotNames(std::vector<std::string> const & names, bool retry = false);
+
   std::vector<Item const *> GetTagged(std::string const & tag);
   std::vector<std::string> GetNames();
   std::vector<std::string> GetNames(std::string const &regex);
@@ -46,25 +86,82 @@ class AddressTable{
   std::string GetRemoteAddress(){return io->GetAddress();};
   std::vector<std::string> GetTables(std::string const &regex);
   uint64_t GetRetryCount(){return io->GetRetryCount();};
+  BNL_UDP_Stats const & GetStats(){return io->GetStats();};
  private:  
   //default constructor is forbidden 
   AddressTable();
   //preventcopying
   AddressTable( const AddressTable & );
   AddressTable& operator=(const AddressTable &);
+  friend class WriteBatch;
+
+  //Register definitions, shared with every other AddressTable built from the same file
+  std::shared_ptr<ParsedAddressTable const> table;
+  //Throws INVALID_NAME if handle wasn't resolved by this table
+  void CheckHandle(RegisterHandle const & handle) const;
+  RegisterSnapshot SnapshotItems(std::vector<Item const *> items, bool retry);
 
-  int fileLevel;
-  void LoadFile(std::string const &, std::string const & prefix = "",uint16_t offset=0);
-  void ProcessLine(std::string const &,size_t,std::string const & prefix = "",uint16_t offset=0);
-  //Ds of entries
-  //req  req     req  req  tokenized
-  //name address mask mode user
-  void AddEntry(Item *);
-  //Map of address to Items (master book-keeping; delete from here)
-  std::map<uint32_t,std::vector<Item*> > addressItemMap;
-  //Map of names to Items
-  std::map<std::string,Item*> nameItemMap;
-
-  BNL_UDP * io;
+  bool shadowEnabled;
+  boost::unordered_map<uint16_t,uint32_t> shadow;
+  //Current value of a register for a masked write, from the shadow if possible
+  uint32_t ReadForWrite(uint16_t address, bool retry);
+  //Write a whole register and track it in the shadow
+  void WriteWord(uint16_t address, uint32_t value, bool retry);
+  void UpdateShadow(uint16_t address, uint32_t value);
+
+  RegisterTransport * io;
 };
+
+template<class REGISTER> RegisterHandle AddressTable::Resolve(){
+  if(table->Fingerprint() != REGISTER::table){
+    return Resolve(REGISTER::name);
+  }
+  RegisterHandle handle;
+  handle.table = this;
+  handle.address = REGISTER::address;
+  handle.mask = REGISTER::mask;
+  handle.offset = REGISTER::offset;
+  handle.mode = REGISTER::mode;
+  return handle;
+}
+
+template<class REGISTER> uint32_t AddressTable::Read(){
+  if(table->Fingerprint() != REGISTER::table){
+    return Read(Resolve(REGISTER::name));
+  }
+  return (Read(REGISTER::address) & REGISTER::mask) >> REGISTER::offset;
+}
+
+template<class REGISTER> uint32_t AddressTable::ReadWithRetry(){
+  if(table->Fingerprint() != REGISTER::table){
+    return ReadWithRetry(Resolve(REGISTER::name));
+  }
+  return (ReadWithRetry(REGISTER::address) & REGISTER::mask) >> REGISTER::offset;
+}
+
+template<class REGISTER> void AddressTable::Write(uint32_t val){
+  if(table->Fingerprint() != REGISTER::table){
+    Write(Resolve(REGISTER::name),val);
+    return;
+  }
+  uint32_t buildingVal = 0;
+  if(REGISTER::mask != 0xFFFFFFFF){
+    //Keep the bits this register doesn't control
+    buildingVal = ReadForWrite(REGISTER::address,false) & ~REGISTER::mask;
+  }
+  WriteWord(REGISTER::address,buildingVal | (REGISTER::mask & (val << REGISTER::offset)),false);
+}
+
+template<class REGISTER> void AddressTable::WriteWithRetry(uint32_t val){
+  if(table->Fingerprint() != REGISTER::table){
+    WriteWithRetry(Resolve(REGISTER::name),val);
+    return;
+  }
+  uint32_t buildingVal = 0;
+  if(REGISTER::mask != 0xFFFFFFFF){
+    //Keep the bits this register doesn't control
+    buildingVal = ReadForWrite(REGISTER::address,true) & ~REGISTER::mask;
+  }
+  WriteWord(REGISTER::address,buildingVal | (REGISTER::mask & (val << REGISTER::offset)),true);
+}
 #endif
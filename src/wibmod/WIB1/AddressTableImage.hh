@@ -0,0 +1,51 @@
+#ifndef __ADDRESSTABLEIMAGE_HH__
+#define __ADDRESSTABLEIMAGE_HH__
+
+#include <stdint.h>
+
+//Binary image of a parsed address table (a root .adt file with all of its includes flattened),
+//written by ParsedAddressTable::WriteImage / wib1_adt_compile and mmapped by ParsedAddressTable::LoadImage.
+//Layout:
+//  AddressTableImageHeader
+//  AddressTableImageSource[source_count]  every file read while parsing, with its content hash
+//  AddressTableImageItem[item_count]      in address order (insertion order within an address)
+//  AddressTableImageUser[user_count]      user fields, items reference a contiguous range
+//  string pool (string_bytes)             NUL terminated strings, referenced by offset into the pool
+//The image is stale (and the .adt files are parsed again) if any source file's hash changed.
+
+#define WIB_ADDRESS_TABLE_IMAGE_MAGIC "WIBADTC"
+#define WIB_ADDRESS_TABLE_IMAGE_VERSION 1
+
+struct AddressTableImageHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t source_count;
+  uint32_t item_count;
+  uint32_t user_count;
+  uint32_t string_bytes;
+  uint32_t reserved;
+};
+
+struct AddressTableImageSource{
+  uint64_t hash;      //64bit FNV-1a of the file contents
+  uint32_t path;      //path the file was opened with
+  uint32_t reserved;
+};
+
+struct AddressTableImageItem{
+  uint32_t name;
+  uint32_t mask;
+  uint32_t user_begin;
+  uint32_t user_count;
+  uint16_t address;
+  uint8_t  offset;
+  uint8_t  mode;
+  uint32_t reserved;
+};
+
+struct AddressTableImageUser{
+  uint32_t key;
+  uint32_t value;
+};
+
+#endif
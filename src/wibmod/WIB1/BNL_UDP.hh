@@ -6,39 +6,103 @@
 
 #include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/ip.h>
 
+#include "wibmod/WIB1/RegisterTransport.hh"
+#include "wibmod/WIB1/BNL_UDP_RetryPolicy.hh"
+#include "wibmod/WIB1/BNL_UDP_Stats.hh"
+
 
 #define WIB_RESPONSE_PACKET_BUFFER_SIZE 4048
+//Number of read requests kept in flight by the pipelined read
+#define WIB_DEFAULT_READ_WINDOW 16
+//Default time to wait for a reply
+#define WIB_DEFAULT_TIMEOUT_US 2000000
 
-class BNL_UDP {
+class BNL_UDP : public RegisterTransport{
 public:
-  BNL_UDP():readSocketFD(-1),writeSocketFD(-1),buffer_size(0),buffer(NULL),total_retry_count(0) {Clear();};
+  BNL_UDP():blockWrite(BLOCK_WRITE_PROBE),probeAddress(-1),batchSyscalls(true),readWindow(WIB_DEFAULT_READ_WINDOW),readSocketFD(-1),writeSocketFD(-1),buffer_size(0),buffer(NULL),lastFailure(FAILURE_TIMEOUT),retryPolicy(new BNL_UDP_RetryPolicy) {Clear();};
   ~BNL_UDP();
 
   void Setup(std::string const & address, uint16_t port_offset = 0); 
+  //Picks the registers used to probe for block writes
+  void TableLoaded(AddressTable & table);
   bool Ready(){return connected;};
 
   void SetWriteAck(bool val){writeAck=val;};
   bool GetWriteAck(){return writeAck;};
+  //Multi-word writes go out as one datagram per block (BLOCK_WRITE_ON) or as one write per word
+  //(BLOCK_WRITE_OFF, for firmware without block writes).
+  //BLOCK_WRITE_PROBE (the default) finds out before the first multi-word write: it writes a two word
+  //block to read-only registers of the address table and latches ON if that is acknowledged, or OFF if
+  //only single writes are.  Without a table (or write acks) it latches ON.
+  //With write acks, a block datagram that isn't acknowledged throws BAD_REPLY and is not re-sent.
+  enum BlockWriteMode{BLOCK_WRITE_OFF,BLOCK_WRITE_ON,BLOCK_WRITE_PROBE};
+  void SetBlockWrite(bool val){blockWrite = val ? BLOCK_WRITE_ON : BLOCK_WRITE_OFF;};
+  void SetBlockWriteMode(BlockWriteMode mode){blockWrite = mode;};
+  BlockWriteMode GetBlockWriteMode(){return blockWrite;};
+  bool GetBlockWrite(){return blockWrite == BLOCK_WRITE_ON;};
+  //Bulk reads/writes use sendmmsg/recvmmsg (false: one send/recv per packet)
+  void SetBatchSyscalls(bool val){batchSyscalls=val;};
+  bool GetBatchSyscalls(){return batchSyscalls;};
+  //Longest reply timeout in microseconds. The retry policy adapts below this, down to
+  //its min timeout (500ms by default); a request is resent once its timeout runs out
+  void SetTimeout(uint32_t microseconds){retryPolicy->SetMaxTimeout(microseconds);};
+  uint32_t GetTimeout(){return retryPolicy->GetMaxTimeout();};
+  //Takes ownership of policy
+  void SetRetryPolicy(BNL_UDP_RetryPolicy * policy);
+  BNL_UDP_RetryPolicy * GetRetryPolicy(){return retryPolicy;};
 
   uint32_t ReadWithRetry(uint16_t address,uint8_t retry_count=10);
   uint32_t Read(uint16_t address);
+  //Pipelined reads: keep up to readWindow requests in flight and match replies by address
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count=10);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  void SetReadWindow(size_t window){readWindow = (window > 0) ? window : 1;};
+  size_t GetReadWindow(){return readWindow;};
   void WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count=10);
   void Write(uint16_t address,uint32_t value);
-  void Write(uint16_t address,std::vector<uint32_t> const & values);
+  using RegisterTransport::Write;
   void Write(uint16_t address,uint32_t const * values, size_t word_count);
 
   std::string GetAddress(){return remoteAddress;};
 
-  uint64_t GetRetryCount(){return total_retry_count;};
+  uint64_t GetRetryCount(){return stats.retries;};
+  BNL_UDP_Stats const & GetStats(){return stats;};
+  void ClearStats(){stats.Clear();};
 
 private:  
   // Prevent copying of BNL_UDP objects
   BNL_UDP( const BNL_UDP& other) ; // prevents construction-copy
   BNL_UDP& operator=( const BNL_UDP&) ; // prevents copying
 
-  void FlushSocket(int sock);
+  //Preallocated message vectors for sendmmsg/recvmmsg
+  struct MessageArena{
+    MessageArena():slotSize(0){};
+    std::vector<struct mmsghdr> headers;
+    std::vector<struct iovec> iovecs;
+    std::vector<uint8_t> data;
+    size_t slotSize;
+  };
+  void ResizeArena(MessageArena & arena, size_t count, size_t slot_size);
+  void SendBatch(int sock, size_t count, uint64_t deadline);
+  int RecvBatch(int sock, uint64_t deadline, size_t max_count);
+
+  ssize_t RecvReply(int sock, uint64_t deadline);
+  ssize_t RecvMatchingReply(int sock, uint64_t deadline, uint16_t address, size_t word_count);
+  void WriteBlock(uint16_t address,uint32_t const * values, size_t word_count);
+  size_t WriteBlocksBatched(uint16_t address,uint32_t const * values, size_t word_count);
+  void CheckRemoteUp(char const * caller);
+  void RecordReceiveFailure();
+  void RecordRetry(uint64_t count = 1);
+  uint32_t ReadAttempt(uint16_t address, uint8_t attempt);
+  void WriteAttempt(uint16_t address, uint32_t value, uint8_t attempt);
+  void SendReadRequest(uint16_t address, uint64_t deadline);
+  size_t ReadPipelined(std::vector<uint16_t> const & addresses,
+		       std::vector<uint32_t> & values,
+		       std::vector<bool> & done,
+		       uint8_t attempt);
 
   //functions
   void Clear();
@@ -46,6 +110,12 @@ private:
   void ResizeBuffer(size_t size  = WIB_RESPONSE_PACKET_BUFFER_SIZE);
   
   bool writeAck;
+  BlockWriteMode blockWrite;
+  //First of two consecutive read-only registers for the block write probe, -1 if there are none
+  int32_t probeAddress;
+  void ProbeBlockWrite();
+  bool batchSyscalls;
+  size_t readWindow;
   
   //Network addresses
   std::string remoteAddress;  
@@ -63,6 +133,12 @@ private:
   //Packet buffer
   size_t buffer_size;
   uint8_t *buffer;
-  uint64_t total_retry_count;
+
+  BNL_UDP_Stats stats;
+  enum {FAILURE_TIMEOUT, FAILURE_ERROR} lastFailure;
+  BNL_UDP_RetryPolicy * retryPolicy;
+
+  MessageArena sendArena;
+  MessageArena recvArena;
 };
 #endif
@@ -0,0 +1,73 @@
+#ifndef __BNL_UDP_EMULATOR_HH__
+#define __BNL_UDP_EMULATOR_HH__
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include <stdint.h>
+#include <netinet/ip.h>
+
+#include "wibmod/WIB1/BNL_UDP_Protocol.hh"
+
+class RegisterModel;
+
+//Answers the BNL_UDP register protocol for one device (WIB or one FEMB) on
+//write port 32000+port_offset and read port 32001+port_offset, backed by a RegisterModel.
+//Replies can be delayed (latency + uniform jitter, so they may reorder) or dropped.
+//Runs its own thread between Start() and Stop().
+class BNL_UDP_Emulator{
+public:
+  BNL_UDP_Emulator(RegisterModel & model, uint16_t port_offset, std::string const & address = "127.0.0.1");
+  ~BNL_UDP_Emulator();
+
+  void SetLatency(uint32_t latency_us, uint32_t jitter_us = 0){latency = latency_us; jitter = jitter_us;};
+  //Fraction (0-1) of requests that are ignored
+  void SetDropRate(double rate){dropRate = rate;};
+  //false: ignore multi-word write packets, like firmware without block write support
+  void SetBlockWrite(bool val){blockWrite = val;};
+
+  void Start();
+  void Stop();
+
+  uint64_t GetRequestCount(){return requestCount;};
+  uint64_t GetDropCount(){return dropCount;};
+
+private:
+  BNL_UDP_Emulator( const BNL_UDP_Emulator& other) ; // prevents construction-copy
+  BNL_UDP_Emulator& operator=( const BNL_UDP_Emulator&) ; // prevents copying
+
+  struct PendingReply{
+    uint64_t due;
+    int sock;
+    struct sockaddr_in to;
+    uint8_t data[WIB_RPLY_PACKET_SIZE];
+    bool operator>(PendingReply const & rhs) const {return due > rhs.due;};
+  };
+
+  void Run();
+  void Handle(int sock, bool writePort, uint8_t const * data, size_t size, struct sockaddr_in const & from);
+  void SendDue(uint64_t now);
+
+  RegisterModel & model;
+  uint16_t portOffset;
+  int readSocketFD;
+  int writeSocketFD;
+
+  uint32_t latency;
+  uint32_t jitter;
+  double dropRate;
+  bool blockWrite;
+  std::mt19937 rng;
+
+  std::priority_queue<PendingReply,std::vector<PendingReply>,std::greater<PendingReply> > pending;
+  std::thread thread;
+  std::atomic<bool> running;
+  std::atomic<uint64_t> requestCount;
+  std::atomic<uint64_t> dropCount;
+};
+
+#endif
@@ -11,6 +11,7 @@ namespace BUException{
   ExceptionClassGenerator(SEND_FAILED,"Failed to send WIB packet\n")
   ExceptionClassGenerator(CONNECTION_FAILED,"Connect failed\n")
   ExceptionClassGenerator(BAD_REPLY,"Bad WIB reply packet\n")
+  ExceptionClassGenerator(BAD_TRANSPORT,"Unknown register transport\n")
 }
 
 
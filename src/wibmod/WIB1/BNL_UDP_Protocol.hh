@@ -0,0 +1,100 @@
+#ifndef __BNL_UDP_PROTOCOL_HH__
+#define __BNL_UDP_PROTOCOL_HH__
+
+#include <stdint.h>
+#include <stddef.h>
+
+//The BNL UDP register protocol, shared by BNL_UDP, BNL_UDP_Reactor and BNL_UDP_Emulator.
+//Everything is big endian.
+//Request: key(32), then addr(16),MSW(16),LSW(16) for each word, then trailer(16).
+//  Reads are sent to the read port and are one word (value ignored), writes go to the write port
+//  and are one word or a block of consecutive registers.
+//Reply (read data or write ack): addr(16),MSW(16),LSW(16) of the request's first word, padded to
+//  WIB_RPLY_PACKET_SIZE.
+
+#define WIB_WR_BASE_PORT 32000
+#define WIB_RD_BASE_PORT 32001
+#define WIB_RPLY_BASE_PORT 32002
+
+#define WIB_PACKET_KEY 0xDEADBEEF
+#define WIB_REQUEST_PACKET_TRAILER 0xFFFF
+//addr, MSW, LSW
+#define WIB_REQUEST_WORD_SIZE 6
+//key + one word + trailer
+#define WIB_REQUEST_PACKET_SIZE (4+WIB_REQUEST_WORD_SIZE+2)
+#define WIB_RPLY_PACKET_SIZE 12
+
+//Largest UDP payload that fits in a standard ethernet frame
+#define WIB_MAX_UDP_PAYLOAD 1472
+//key + N*(addr,MSW,LSW) + trailer
+#define WIB_MAX_BLOCK_WRITE_WORDS ((WIB_MAX_UDP_PAYLOAD - 4 - 2)/WIB_REQUEST_WORD_SIZE)
+
+static inline void WIBPut16(uint8_t * data, uint16_t value){
+  data[0] = value >> 8;
+  data[1] = value & 0xFF;
+}
+
+static inline uint16_t WIBGet16(uint8_t const * data){
+  return uint16_t(data[0] << 8 | data[1]);
+}
+
+static inline uint32_t WIBGet32(uint8_t const * data){
+  return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+//Request for word_count consecutive registers starting at address into packet, which must hold
+//4 + WIB_REQUEST_WORD_SIZE*word_count + 2 bytes. Returns the packet size.
+static inline size_t BuildWIBRequest(uint8_t * packet, uint16_t address, uint32_t const * values, size_t word_count){
+  WIBPut16(packet+0,WIB_PACKET_KEY >> 16);
+  WIBPut16(packet+2,WIB_PACKET_KEY & 0xFFFF);
+  uint8_t * word = packet + 4;
+  for(size_t iWord = 0; iWord < word_count;iWord++){
+    WIBPut16(word+0,uint16_t(address+iWord));
+    WIBPut16(word+2,uint16_t(values[iWord] >> 16));
+    WIBPut16(word+4,uint16_t(values[iWord] & 0xFFFF));
+    word += WIB_REQUEST_WORD_SIZE;
+  }
+  WIBPut16(word,WIB_REQUEST_PACKET_TRAILER);
+  return (word + 2) - packet;
+}
+
+//Single register request (WIB_REQUEST_PACKET_SIZE bytes), value is ignored for reads
+static inline size_t BuildWIBRequest(uint8_t * packet, uint16_t address, uint32_t value = 0){
+  return BuildWIBRequest(packet,address,&value,1);
+}
+
+//Words in a request of size bytes, 0 if it isn't a well formed request
+static inline size_t WIBRequestWordCount(uint8_t const * packet, size_t size){
+  if(size < WIB_REQUEST_PACKET_SIZE || ((size - 6) % WIB_REQUEST_WORD_SIZE) != 0 || WIBGet32(packet) != WIB_PACKET_KEY){
+    return 0;
+  }
+  return (size - 6)/WIB_REQUEST_WORD_SIZE;
+}
+
+//Address and value of word iWord of a request
+static inline uint16_t WIBRequestAddress(uint8_t const * packet, size_t iWord){
+  return WIBGet16(packet + 4 + WIB_REQUEST_WORD_SIZE*iWord);
+}
+static inline uint32_t WIBRequestValue(uint8_t const * packet, size_t iWord){
+  return WIBGet32(packet + 4 + WIB_REQUEST_WORD_SIZE*iWord + 2);
+}
+
+//Reply into reply (WIB_RPLY_PACKET_SIZE bytes)
+static inline void BuildWIBReply(uint8_t * reply, uint16_t address, uint32_t value){
+  WIBPut16(reply+0,address);
+  WIBPut16(reply+2,uint16_t(value >> 16));
+  WIBPut16(reply+4,uint16_t(value & 0xFFFF));
+  for(size_t i = 6; i < WIB_RPLY_PACKET_SIZE;i++){
+    reply[i] = 0;
+  }
+}
+
+//Address and value of a reply (at least WIB_RPLY_PACKET_SIZE bytes)
+static inline uint16_t WIBReplyAddress(uint8_t const * reply){
+  return WIBGet16(reply);
+}
+static inline uint32_t WIBReplyValue(uint8_t const * reply){
+  return WIBGet32(reply+2);
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef __BNL_UDP_REACTOR_HH__
+#define __BNL_UDP_REACTOR_HH__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/BNL_UDP.hh"
+#include "wibmod/WIB1/BNL_UDP_RetryPolicy.hh"
+#include "wibmod/WIB1/BNL_UDP_Stats.hh"
+
+//One thread driving the BNL_UDP protocol for many WIBs/FEMBs at once.
+//Each session is one device (address + port offset) with its own read and write socket;
+//all sockets sit in one epoll set. Requests can be queued from any thread and complete
+//through a callback (run on the reactor thread, so it must not block) or a future.
+//Each session keeps up to its window of reads in flight, with the same retry policy
+//and stats as BNL_UDP.
+//A completion that throws is reported on stderr and otherwise ignored.
+//Writes on one session are sent in the order they were queued, one at a time (including
+//resends), so write sequences like I2C control word then RUN stay ordered.
+//Reads and writes may complete out of order with respect to each other: wait for a
+//write to complete before reading back a register it changes.
+class BNL_UDP_Reactor{
+public:
+  //success is false if the request failed (timed out after all retries, or the remote is down)
+  //value is the register value for reads and the acknowledged value for writes
+  typedef std::function<void(bool success, uint32_t value)> Completion;
+
+  BNL_UDP_Reactor();
+  ~BNL_UDP_Reactor();
+
+  //Returns the session id used for the requests below (thread safe)
+  int AddSession(std::string const & address, uint16_t port_offset = 0);
+  //Closes the session's sockets; its queued and in flight requests fail. The id is invalid from here on
+  void RemoveSession(int session);
+  //Reads in flight per session (writes are always one at a time)
+  void SetWindow(int session, size_t window);
+
+  void Read(int session, uint16_t address, Completion done, uint8_t retry_count=10);
+  void Write(int session, uint16_t address, uint32_t value, Completion done, uint8_t retry_count=10);
+  //Futures throw BUException::BAD_REPLY from get() on failure
+  std::future<uint32_t> Read(int session, uint16_t address, uint8_t retry_count=10);
+  std::future<std::vector<uint32_t> > Read(int session, std::vector<uint16_t> const & addresses, uint8_t retry_count=10);
+  std::future<void> Write(int session, uint16_t address, uint32_t value, uint8_t retry_count=10);
+
+  BNL_UDP_Stats const & GetStats(int session);
+  void ClearStats(int session);
+
+private:
+  BNL_UDP_Reactor( const BNL_UDP_Reactor& other) ; // prevents construction-copy
+  BNL_UDP_Reactor& operator=( const BNL_UDP_Reactor&) ; // prevents copying
+
+  struct Request{
+    int session;
+    bool write;
+    uint16_t address;
+    uint32_t value;
+    uint8_t attempt;
+    uint8_t retry_count;
+    uint64_t sent;
+    uint64_t deadline;
+    Completion done;
+  };
+  //One socket of a session
+  struct Channel{
+    int fd;
+    std::deque<Request> queued;
+    std::vector<Request> inflight;
+  };
+  struct Session{
+    std::string address;
+    uint16_t portOffset;
+    Channel channel[2]; //read, write
+    std::atomic<size_t> window;
+    bool removed; //under mutex, closed by the reactor thread
+    BNL_UDP_RetryPolicy retryPolicy;
+    BNL_UDP_Stats stats;
+  };
+
+  Session * GetSession(int session);
+  void Submit(Request const & request);
+
+  //Reactor thread
+  void Run();
+  void TakeSubmitted();
+  void Close(Session * session);
+  void Receive(Session & session, int iChannel);
+  void Expire(Session & session, int iChannel, uint64_t now);
+  void Issue(Session & session, int iChannel, uint64_t now);
+  void Send(Session & session, int iChannel, Request & request, uint64_t now);
+  uint64_t NextDeadline();
+
+  int epollFD;
+  int wakeFD;
+
+  //Shared with the callers, under mutex
+  std::mutex mutex;
+  std::vector<Session *> sessions;
+  std::vector<Request> submitted;
+
+  //Only touched by the reactor thread (NULL for removed sessions)
+  std::vector<Session *> active;
+
+  std::thread thread;
+  std::atomic<bool> running;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __BNL_UDP_RETRYPOLICY_HH__
+#define __BNL_UDP_RETRYPOLICY_HH__
+
+#include <stdint.h>
+
+//Defaults (microseconds)
+//The floor is kept well above the slowest WIB reply: a resend of a reply that was only
+//late fires action bits (I2C RUN, FEMB_CNC, SPI/ASIC triggers) again and can drop data
+//from FIFO-backed reads. Until the first reply, the baseline's fixed 2s is used.
+#define WIB_RETRY_INITIAL_RTO_US  2000000
+#define WIB_RETRY_MIN_RTO_US       500000
+#define WIB_RETRY_BACKOFF_BASE_US      10
+#define WIB_RETRY_BACKOFF_MAX_US    10000
+#define WIB_RETRY_PROBE_INTERVAL_US 1000000
+//Consecutive timeouts before a remote is treated as down
+#define WIB_RETRY_DOWN_THRESHOLD 5
+//Attempts every call may make whatever the budget or circuit breaker say (the old fixed retry count)
+#define WIB_RETRY_BASELINE_ATTEMPTS 10
+//Retry budget: a retry past the baseline spends a token, a success gives back a tenth of one
+#define WIB_RETRY_BUDGET_MAX 10.0
+#define WIB_RETRY_BUDGET_REFILL 0.1
+
+//Decides how long BNL_UDP waits for a reply and whether a failed request is tried again.
+//One instance per BNL_UDP (i.e. per remote device/port), so the RTT estimate is per remote.
+//The default implementation:
+//  - keeps a smoothed RTT and RTT variance (RFC 6298) and uses RTO = SRTT + 4*RTTVAR,
+//    clamped to [min timeout, max timeout] (default [500ms, 2s]). A request is resent
+//    after this timeout instead of the fixed 2s used before, so never lower the min
+//    timeout below the worst-case reply time of the remote.
+//  - doubles the timeout and the inter-retry sleep on each retry
+//  - limits retries with a token bucket so a flaky link can't multiply traffic. The budget only
+//    applies past WIB_RETRY_BASELINE_ATTEMPTS: a call still gets the retry_count it asked for up to
+//    that (10, the default), as it did before, so it only limits callers asking for more.
+//  - marks the remote down after WIB_RETRY_DOWN_THRESHOLD consecutive timeouts. Requests then
+//    fail immediately, except for one probe per probe interval; any reply brings it back up.
+//Derive from this class and pass it to BNL_UDP::SetRetryPolicy to change the behaviour.
+class BNL_UDP_RetryPolicy{
+public:
+  BNL_UDP_RetryPolicy();
+  virtual ~BNL_UDP_RetryPolicy(){};
+
+  //Reply timeout (us) for attempt number attempt (0 is the first try)
+  virtual uint32_t Timeout(uint8_t attempt);
+  //Sleep (us) before attempt number attempt
+  virtual uint32_t Backoff(uint8_t attempt);
+  //false if the remote is down and the request should fail without being sent
+  virtual bool Allow();
+  //false if attempt number attempt should not be made. Always true below WIB_RETRY_BASELINE_ATTEMPTS
+  virtual bool AllowRetry(uint8_t attempt);
+
+  //Outcome of one attempt. rtt_us == 0 means no RTT sample (e.g. the reply could belong to an earlier try)
+  virtual void RecordSuccess(uint32_t rtt_us);
+  virtual void RecordTimeout();
+
+  void SetMaxTimeout(uint32_t us);
+  uint32_t GetMaxTimeout(){return maxTimeout;};
+  void SetMinTimeout(uint32_t us);
+  uint32_t GetMinTimeout(){return minTimeout;};
+  uint32_t GetRTO(){return rto;};
+  uint32_t GetSRTT(){return srtt;};
+  uint32_t GetRTTVar(){return rttvar;};
+  bool IsDown(){return down;};
+  void Reset();
+
+protected:
+  uint32_t minTimeout;
+  uint32_t maxTimeout;
+
+  //RTT estimator
+  bool haveSample;
+  uint32_t srtt;
+  uint32_t rttvar;
+  uint32_t rto;
+
+  //Retry budget
+  double budget;
+
+  //Circuit breaker
+  uint32_t consecutiveTimeouts;
+  bool down;
+  uint64_t lastProbe;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __BNL_UDP_STATS_HH__
+#define __BNL_UDP_STATS_HH__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+//Log-linear (HDR style) latency histogram in microseconds.
+//Values below 2^WIB_LATENCY_SUB_BUCKET_BITS get their own bucket, above that each power of two
+//is split into 2^WIB_LATENCY_SUB_BUCKET_BITS buckets, so bucket widths are within 1/16 (~6%) of the value.
+//Recording is a few relaxed atomic adds, so it is safe to read from a monitoring thread
+//while the transport is in use.
+#define WIB_LATENCY_SUB_BUCKET_BITS 4
+#define WIB_LATENCY_SUB_BUCKETS (1 << WIB_LATENCY_SUB_BUCKET_BITS)
+//covers up to 2^32 us
+#define WIB_LATENCY_BUCKETS ((32 - WIB_LATENCY_SUB_BUCKET_BITS + 1)*WIB_LATENCY_SUB_BUCKETS)
+
+class BNL_UDP_LatencyHistogram{
+public:
+  BNL_UDP_LatencyHistogram(){Clear();};
+
+  void Record(uint64_t us){
+    if(us > 0xFFFFFFFF){
+      us = 0xFFFFFFFF;
+    }
+    counts[Bucket(us)].fetch_add(1,std::memory_order_relaxed);
+    count.fetch_add(1,std::memory_order_relaxed);
+    sum.fetch_add(us,std::memory_order_relaxed);
+    uint64_t currentMax = max.load(std::memory_order_relaxed);
+    while(us > currentMax && !max.compare_exchange_weak(currentMax,us,std::memory_order_relaxed)){
+    }
+  };
+  void Clear();
+
+  uint64_t Count() const {return count.load(std::memory_order_relaxed);};
+  uint64_t Sum() const {return sum.load(std::memory_order_relaxed);};
+  uint64_t Max() const {return max.load(std::memory_order_relaxed);};
+  //Add this histogram's bucket counts to buckets (WIB_LATENCY_BUCKETS entries) to merge histograms
+  void AddTo(uint64_t * buckets) const;
+
+  static size_t Bucket(uint64_t us){
+    if(us < WIB_LATENCY_SUB_BUCKETS){
+      return size_t(us);
+    }
+    int msb = 63 - __builtin_clzll(us);
+    int shift = msb - WIB_LATENCY_SUB_BUCKET_BITS;
+    return size_t((shift + 1) << WIB_LATENCY_SUB_BUCKET_BITS) + size_t((us >> shift) & (WIB_LATENCY_SUB_BUCKETS - 1));
+  };
+  static uint64_t BucketLowerBound(size_t bucket);
+  //Value below which fraction of the samples in buckets fall (upper edge of that bucket)
+  static uint64_t Percentile(uint64_t const * buckets, double fraction);
+
+private:
+  std::atomic<uint64_t> counts[WIB_LATENCY_BUCKETS];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+};
+
+//Transport counters, updated with relaxed atomics
+struct BNL_UDP_Stats{
+  BNL_UDP_Stats(){Clear();};
+  void Clear();
+
+  //Retries
+  std::atomic<uint64_t> retries;          //requests sent again after a failed attempt
+  std::atomic<uint64_t> retry_timeout;    //  ... because no reply came in time
+  std::atomic<uint64_t> retry_error;      //  ... because the socket reported an error (e.g. ICMP unreachable)
+  //Reply problems
+  std::atomic<uint64_t> timeouts;         //waits for a reply that ran out of time
+  std::atomic<uint64_t> bad_address;      //replies dropped because they echoed an address we weren't waiting on
+  std::atomic<uint64_t> short_replies;    //replies dropped for being shorter than a reply packet
+  std::atomic<uint64_t> stale_drains;     //receives that had to drop stale packets before finding their reply
+  std::atomic<uint64_t> fail_fast;        //requests refused because the remote was marked down
+  std::atomic<uint64_t> block_write_failures; //block writes with unacknowledged datagrams (not re-sent)
+  std::atomic<uint64_t> per_word_writes;  //multi-word writes sent one word at a time (block writes off)
+  //Traffic
+  std::atomic<uint64_t> packets_sent;
+  std::atomic<uint64_t> bytes_sent;
+  std::atomic<uint64_t> packets_received;
+  std::atomic<uint64_t> bytes_received;
+  //Request to reply latency
+  BNL_UDP_LatencyHistogram read_latency;
+  BNL_UDP_LatencyHistogram write_latency;
+};
+
+#endif
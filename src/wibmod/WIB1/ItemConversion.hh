@@ -2,15 +2,24 @@
 #define ITEMCONVERSION_HH_
 
 #include <string>
+#include <vector>
 #include <boost/unordered_map.hpp>
 
+#include <stdint.h>
+
+class Item;
+
 class ItemConversion {
+public:
+  //Which conversion this is, so batches can call it without a virtual call
+  enum Kind{OTHER=0,PASS,LINEAR,ENUM};
 protected:
   size_t data_size;
   std::string data_description;
-  ItemConversion(){}
+  Kind kind;
+  ItemConversion():kind(OTHER){}
   ItemConversion
-    (boost::unordered_map<std::string, std::string> ) { }
+    (boost::unordered_map<std::string, std::string> ):kind(OTHER) { }
 public:
   virtual ~ItemConversion() { }
   size_t DataSize() {
@@ -19,11 +28,48 @@ public:
   std::string DataDescription() {
     return data_description;
   }
+  Kind GetKind() const {
+    return kind;
+  }
   virtual void Convert(uint32_t src, void *dest) = 0;
+  //New conversion owned by the caller, NULL if the conversion is unknown
   static ItemConversion * FromString(std::string convstring);
+  //Conversion shared by everything with the same convstring, owned by the library
+  //and valid for the life of the process, NULL if the conversion is unknown
+  static ItemConversion * Get(std::string const & convstring);
 
 
 
 };
 
+//Converts the values of a fixed set of items in one call, into one buffer laid out
+//like the items' DataSize()s back to back.  The items are grouped by conversion kind
+//and each group is converted in its own loop without virtual calls.
+class ItemConversionBatch {
+public:
+  ItemConversionBatch(std::vector<Item const *> const & items);
+  //Bytes Convert writes
+  size_t OutputSize() const {return outputSize;};
+  //Where item iItem's value starts in the output
+  size_t Offset(size_t iItem) const {return offsets[iItem];};
+  //values[i] is item i's field value (already masked and shifted)
+  void Convert(uint32_t const * values, void * dest) const;
+private:
+  size_t outputSize;
+  std::vector<size_t> offsets;
+  //Per kind: the items' indexes and output offsets, plus what each kind needs
+  struct Group{
+    std::vector<uint32_t> index;
+    std::vector<size_t> offset;
+  };
+  Group pass;
+  Group linear;
+  std::vector<double> linearScale;
+  std::vector<double> linearOffset;
+  Group enums;
+  std::vector<ItemConversion *> enumConv;
+  Group other;
+  std::vector<ItemConversion *> otherConv;
+};
+
 #endif
@@ -0,0 +1,41 @@
+#ifndef __MEMORYTRANSPORT_HH__
+#define __MEMORYTRANSPORT_HH__
+
+#include "wibmod/WIB1/RegisterTransport.hh"
+#include "wibmod/WIB1/RegisterModel.hh"
+
+//In-process register file behind the RegisterTransport interface (address "mem://name").
+//The registers are seeded from the device's address table (see RegisterModel), so the
+//WIB configuration sequences run without hardware and without network cost.
+//Traffic counters count one packet per word, there are never retries.
+class MemoryTransport : public RegisterTransport{
+public:
+  MemoryTransport(std::string const & _name):name(_name){};
+
+  void TableLoaded(AddressTable & table){model.Seed(table);};
+  RegisterModel & GetModel(){return model;};
+
+  uint32_t ReadWithRetry(uint16_t address,uint8_t retry_count=10);
+  uint32_t Read(uint16_t address);
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count=10);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  void WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count=10);
+  void Write(uint16_t address,uint32_t value);
+  void Write(uint16_t address,uint32_t const * values, size_t word_count);
+  using RegisterTransport::Write;
+
+  std::string GetAddress(){return "mem://" + name;};
+
+  BNL_UDP_Stats const & GetStats(){return stats;};
+  void ClearStats(){stats.Clear();};
+
+private:
+  MemoryTransport( const MemoryTransport& other) ; // prevents construction-copy
+  MemoryTransport& operator=( const MemoryTransport&) ; // prevents copying
+
+  std::string name;
+  RegisterModel model;
+  BNL_UDP_Stats stats;
+};
+
+#endif
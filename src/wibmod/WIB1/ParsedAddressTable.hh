@@ -0,0 +1,113 @@
+#ifndef __PARSEDADDRESSTABLE_HH__
+#define __PARSEDADDRESSTABLE_HH__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <map>
+#include <memory>
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/ItemConversion.hh"
+
+class Item{
+public:
+  enum ModeMask{EMPTY=0x0,READ = 0x1,WRITE =0x2, ACTION = 0x4};
+  std::string name;
+  uint16_t address;
+  uint32_t mask;
+  uint8_t  offset;
+  uint8_t  mode; // r :0, w :1, a:2
+  boost::unordered_map<std::string,std::string> user;
+  ItemConversion *sc_conv; //shared, see ItemConversion::Get
+};
+
+//The register definitions parsed from an .adt file (and its includes).
+//Immutable once loaded and shared by every AddressTable built from the same file,
+//so the four FEMB tables of a WIB (and the tables of every WIB in a process) parse
+//and store the definitions once.
+class ParsedAddressTable{
+public:
+  //Returns the cached table for fileName, parsing it on first use (thread safe).
+  //The table lives as long as any AddressTable holds it.
+  //If $WIBMOD_ADT_CACHE is set, the first use in a process loads the table's binary image
+  //from that directory instead of parsing, and (re)writes the image when it is missing or stale.
+  static std::shared_ptr<ParsedAddressTable const> Get(std::string const & fileName);
+  //Always parses the .adt files, bypassing both caches
+  static std::shared_ptr<ParsedAddressTable const> Parse(std::string const & fileName);
+  ~ParsedAddressTable();
+
+  //Image file for fileName in $WIBMOD_ADT_CACHE, empty if the variable isn't set
+  static std::string ImagePath(std::string const & fileName);
+  //Write the table as a binary image (see AddressTableImage.hh), throws BAD_FILE
+  void WriteImage(std::string const & path) const;
+  //Every file read while parsing
+  std::vector<std::string> const & SourceFiles() const {return sourceFiles;};
+  size_t ItemCount() const {return nameItemMap.size();};
+  //64bit FNV-1a of every item's name, address, mask and mode, matched against the
+  //fingerprint scripts/wib1_adt_codegen.py puts in the generated register descriptors
+  uint64_t Fingerprint() const {return fingerprint;};
+
+  Item const * FindItem(std::string_view name) const;
+  //FindItem that throws INVALID_NAME
+  Item const * LookupItem(std::string_view name) const;
+private:
+  friend class AddressTable;
+  ParsedAddressTable();
+  //preventcopying
+  ParsedAddressTable( const ParsedAddressTable & );
+  ParsedAddressTable& operator=(const ParsedAddressTable &);
+
+  int fileLevel;
+  void LoadFile(std::string const &, std::string const & prefix = "",uint16_t offset=0);
+  void ProcessLine(std::string const &,size_t,std::string const & prefix = "",uint16_t offset=0);
+  //Ds of entries
+  //req  req     req  req  tokenized
+  //name address mask mode user
+  void AddEntry(Item *);
+  //Files read while parsing, as opened
+  std::vector<std::string> sourceFiles;
+
+  //Fill an empty table from an image, false if it is missing, malformed or stale
+  bool LoadImage(std::string const & path);
+  static bool HashFile(std::string const & path, uint64_t & hash);
+
+  //Map of address to Items (master book-keeping; delete from here)
+  std::map<uint32_t,std::vector<Item*> > addressItemMap;
+  //Map of names to Items (ordered, for the searches)
+  std::map<std::string,Item*> nameItemMap;
+
+  //Flat open-addressing (linear probe) FNV-1a index of nameItemMap for the named accesses.
+  //The item names are the interned keys; a slot holds the full hash so probes only
+  //compare strings on a hash match.
+  struct NameSlot{
+    uint64_t hash;
+    Item * item;
+  };
+  std::vector<NameSlot> nameIndex;
+  size_t nameIndexCount;
+  static uint64_t HashName(std::string_view name);
+  void IndexName(Item * item);
+
+  uint64_t fingerprint;
+  void ComputeFingerprint();
+
+  //Items carrying each user field/flag (e.g. "slowcontrol"), in name order
+  boost::unordered_map<std::string,std::vector<Item const *> > tagIndex;
+  //Distinct values of the "Table" user field, sorted
+  std::vector<std::string> tableNames;
+  void BuildSearchIndexes();
+
+  //Addresses whose last written/read value can stand in for a read before a masked write
+  //(see AddressTable::EnableShadow), mapped to their action (self-clearing) bits.
+  //Addresses with an item tagged "volatile" are left out.
+  boost::unordered_map<uint16_t,uint32_t> shadowPulseMasks;
+  void BuildShadowPolicy();
+
+  //Call once all the items are added: fingerprint, search indexes and shadow policy
+  void Finalize();
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __REACTORTRANSPORT_HH__
+#define __REACTORTRANSPORT_HH__
+
+#include "wibmod/WIB1/RegisterTransport.hh"
+
+class BNL_UDP_Reactor;
+
+//BNL_UDP protocol through one session of a process-wide BNL_UDP_Reactor (address "reactor://host").
+//Every WIB and FEMB opened this way shares the reactor's single thread instead of blocking
+//on its own sockets, and bulk reads keep the session's window of reads in flight.
+//Calls block on the reactor's futures and throw BUException::BAD_REPLY like BNL_UDP.
+//There is no block write: a multi-word write is queued as one write per word, which the
+//reactor sends in order.
+class ReactorTransport : public RegisterTransport{
+public:
+  ReactorTransport(std::string const & remote, uint16_t port_offset = 0);
+  ~ReactorTransport();
+
+  uint32_t ReadWithRetry(uint16_t address,uint8_t retry_count=10);
+  uint32_t Read(uint16_t address);
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count=10);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  void WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count=10);
+  void Write(uint16_t address,uint32_t value);
+  void Write(uint16_t address,uint32_t const * values, size_t word_count);
+  using RegisterTransport::Write;
+
+  std::string GetAddress(){return "reactor://" + remote;};
+
+  BNL_UDP_Stats const & GetStats();
+  void ClearStats();
+
+  //The reactor shared by every ReactorTransport, started on first use
+  static BNL_UDP_Reactor & SharedReactor();
+
+private:
+  ReactorTransport( const ReactorTransport& other) ; // prevents construction-copy
+  ReactorTransport& operator=( const ReactorTransport&) ; // prevents copying
+
+  std::string remote;
+  int session;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __RECORDINGTRANSPORT_HH__
+#define __RECORDINGTRANSPORT_HH__
+
+#include "wibmod/WIB1/RegisterTransport.hh"
+#include "wibmod/WIB1/TransactionLog.hh"
+
+#define WIB_TRANSACTION_LOG_BUFFER 256
+
+//Passes every call through to another transport and appends a TransactionRecord per word
+//to a log file (see TransactionLog.hh), selected with "?record=<file>" on the device address.
+//Records are buffered and written with one append per WIB_TRANSACTION_LOG_BUFFER records,
+//and on Flush()/destruction.
+class RecordingTransport : public RegisterTransport{
+public:
+  //Takes ownership of transport
+  RecordingTransport(RegisterTransport * transport, std::string const & logFile, uint16_t port_offset);
+  ~RecordingTransport();
+
+  void TableLoaded(AddressTable & table){transport->TableLoaded(table);};
+
+  uint32_t ReadWithRetry(uint16_t address,uint8_t retry_count=10);
+  uint32_t Read(uint16_t address);
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count=10);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  void WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count=10);
+  void Write(uint16_t address,uint32_t value);
+  void Write(uint16_t address,uint32_t const * values, size_t word_count);
+  using RegisterTransport::Write;
+
+  std::string GetAddress(){return transport->GetAddress();};
+
+  BNL_UDP_Stats const & GetStats(){return transport->GetStats();};
+  void ClearStats(){transport->ClearStats();};
+
+  void Flush();
+
+private:
+  RecordingTransport( const RecordingTransport& other) ; // prevents construction-copy
+  RecordingTransport& operator=( const RecordingTransport&) ; // prevents copying
+
+  //Bookkeeping around one call to the wrapped transport
+  struct Call{
+    uint64_t timestamp_ns;
+    uint64_t start_us;
+    uint64_t retries;
+  };
+  Call Begin();
+  void Add(Call const & call, uint8_t op, uint16_t address, uint32_t value, uint8_t flags);
+
+  RegisterTransport * transport;
+  uint16_t portOffset;
+  int logFD;
+  TransactionRecord buffer[WIB_TRANSACTION_LOG_BUFFER];
+  size_t buffered;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __REGISTER_HH__
+#define __REGISTER_HH__
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+
+//Compile-time description of an address table entry.
+//The types generated into wibmod/WIB1/Registers.hh by scripts/wib1_adt_codegen.py
+//(e.g. regs::DTS::PDTS_STATE) derive from this and add the register's name.
+//TABLE is the fingerprint of the table they were generated from; AddressTable only trusts
+//the constants if the table it loaded has the same fingerprint (see AddressTable::Read<>).
+template<uint64_t TABLE, uint16_t ADDRESS, uint32_t MASK, uint8_t MODE>
+struct Register{
+  static constexpr uint64_t table = TABLE;
+  static constexpr uint16_t address = ADDRESS;
+  static constexpr uint32_t mask = MASK;
+  //Same as the shift AddressTable derives from the mask
+  static constexpr uint8_t offset = (MASK == 0) ? 32 : __builtin_ctz(MASK);
+  static constexpr uint8_t mode = MODE;
+};
+
+#endif
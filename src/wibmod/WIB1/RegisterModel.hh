@@ -0,0 +1,44 @@
+#ifndef __REGISTERMODEL_HH__
+#define __REGISTERMODEL_HH__
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include <stdint.h>
+
+class AddressTable;
+class Item;
+
+//In-memory register file behaving like the WIB/FEMB firmware registers described by an address table.
+//  - bits only covered by read-only items keep their value on writes
+//  - action bits read back as 0 (they pulse)
+//  - status bits that report "good" (names ending in DONE, READY, EMPTY or containing LOCKED) read as 1,
+//    PDTS_STATE reads as RUN (8), FEMB_COUNT and DAQ_LINK_COUNT as 4 (RCE firmware)
+//  - addresses not in the table behave as plain 32bit memory
+class RegisterModel{
+public:
+  RegisterModel(){};
+
+  //Add the registers described by a loaded address table
+  void Seed(AddressTable & table);
+
+  //Firmware-like access (read-only and action masks apply)
+  uint32_t Read(uint16_t address);
+  void Write(uint16_t address, uint32_t value);
+
+  //Force a value (ignores the read-only mask), for setting up a scenario
+  void Set(uint16_t address, uint32_t value);
+  void Set(Item const * item, uint32_t value);
+
+private:
+  struct Register{
+    Register():value(0),readOnlyMask(0),actionMask(0){};
+    uint32_t value;
+    uint32_t readOnlyMask;
+    uint32_t actionMask;
+  };
+  boost::unordered_map<uint16_t,Register> registers;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __REGISTERSNAPSHOT_HH__
+#define __REGISTERSNAPSHOT_HH__
+
+#include <string_view>
+#include <vector>
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/ParsedAddressTable.hh"
+
+//Values of a set of fields, all decoded from one bulk read of the registers behind them
+//(see AddressTable::Snapshot).  Fields that share a register cost a single read.
+class RegisterSnapshot{
+public:
+  struct Field{
+    Item const * item;
+    uint32_t value;
+  };
+  //Fields in name order
+  std::vector<Field> const & Fields() const {return fields;};
+  size_t Size() const {return fields.size();};
+  bool Has(std::string_view registerName) const;
+  //Throws INVALID_NAME if registerName isn't in the snapshot. Names are case insensitive, as in the table
+  uint32_t Get(std::string_view registerName) const;
+
+  //The registers read, in address order, and their values
+  std::vector<uint16_t> const & Addresses() const {return addresses;};
+  std::vector<uint32_t> const & Words() const {return words;};
+private:
+  friend class AddressTable;
+  Field const * Find(std::string_view registerName) const;
+
+  std::vector<Field> fields;
+  std::vector<uint16_t> addresses;
+  std::vector<uint32_t> words;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __REGISTERTRANSPORT_HH__
+#define __REGISTERTRANSPORT_HH__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/BNL_UDP_Stats.hh"
+
+class AddressTable;
+
+//Register access used by AddressTable, implemented by BNL_UDP (the WIB firmware over UDP),
+//ReactorTransport (the same protocol on the shared reactor thread) and MemoryTransport
+//(an in-process register file, for running the configuration code at CPU speed)
+class RegisterTransport{
+public:
+  virtual ~RegisterTransport(){};
+
+  //Build a transport from a device address:
+  //  udp://host  or just host (also crate.slot)  BNL_UDP to host, ports 32000/32001 + port_offset
+  //  mem://name                                  MemoryTransport
+  //  reactor://host                              ReactorTransport, a session on the shared BNL_UDP_Reactor
+  //Appending "?record=<file>" wraps the transport in a RecordingTransport logging to file
+  static RegisterTransport * Create(std::string const & address, uint16_t port_offset = 0);
+
+  //Called once the address table for this device has been loaded
+  virtual void TableLoaded(AddressTable &){};
+
+  virtual uint32_t ReadWithRetry(uint16_t address,uint8_t retry_count=10) = 0;
+  virtual uint32_t Read(uint16_t address) = 0;
+  virtual std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses,uint8_t retry_count=10) = 0;
+  virtual std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses) = 0;
+  virtual void WriteWithRetry(uint16_t address, uint32_t value, uint8_t retry_count=10) = 0;
+  virtual void Write(uint16_t address,uint32_t value) = 0;
+  virtual void Write(uint16_t address,uint32_t const * values, size_t word_count) = 0;
+  void Write(uint16_t address,std::vector<uint32_t> const & values){
+    Write(address,values.data(),values.size());
+  };
+
+  virtual std::string GetAddress() = 0;
+
+  uint64_t GetRetryCount(){return GetStats().retries;};
+  virtual BNL_UDP_Stats const & GetStats() = 0;
+  virtual void ClearStats() = 0;
+};
+
+#endif
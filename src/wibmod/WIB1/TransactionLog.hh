@@ -0,0 +1,56 @@
+#ifndef __TRANSACTIONLOG_HH__
+#define __TRANSACTIONLOG_HH__
+
+#include <string>
+#include <stdint.h>
+
+//Binary register transaction log, written by RecordingTransport and read by wib1_replay.
+//The file is a TransactionLogHeader followed by fixed size TransactionRecords,
+//only ever appended to, so it can be mmapped and indexed directly.
+//Several transports (WIB + FEMBs) may append to the same file; records are written in
+//chunks, so sort by timestamp to get the global order.
+
+#define WIB_TRANSACTION_LOG_MAGIC "WIBTXLOG"
+#define WIB_TRANSACTION_LOG_VERSION 1
+
+struct TransactionLogHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+struct TransactionRecord{
+  enum Op{READ = 0, WRITE = 1};
+  enum Flags{FAILED = 0x1,      //the transport threw, value is not valid
+	     BULK = 0x2,        //part of a multi-word read/write
+	     BULK_START = 0x4,  //first word of a multi-word read/write
+	     RETRY = 0x8};      //issued through the ...WithRetry call
+  uint64_t timestamp_ns;  //CLOCK_REALTIME at the start of the transaction
+  uint32_t value;
+  uint32_t latency_us;    //whole call, shared by every word of a bulk transaction
+  uint16_t address;
+  uint16_t port_offset;   //0 for the WIB, 0x10*(iFEMB+1) for FEMBs
+  uint8_t op;
+  uint8_t retries;        //saturates at 255, counted on the first word of a bulk transaction
+  uint8_t flags;
+  uint8_t reserved;
+};
+
+//Read-only mmap of a transaction log
+class TransactionLogFile{
+public:
+  TransactionLogFile(std::string const & path);
+  ~TransactionLogFile();
+  size_t Count() const {return count;};
+  TransactionRecord const * Records() const {return records;};
+private:
+  TransactionLogFile( const TransactionLogFile& other) ; // prevents construction-copy
+  TransactionLogFile& operator=( const TransactionLogFile&) ; // prevents copying
+
+  void * map;
+  size_t mapSize;
+  TransactionRecord const * records;
+  size_t count;
+};
+
+#endif
@@ -35,14 +35,23 @@ class WIB: public WIBBase {
   //initialize hardware
   void InitializeWIB();
   void ResetWIB(bool reset_udp=false);
+  //PDTSAlignment_timeout in ms
   void InitializeDTS(uint8_t PDTSsource = 0,uint8_t clockSource = 0, uint32_t PDTSAlignment_timeout = 0 /*default infinite*/);
   void EnableDAQLink(uint8_t iDAQLink);
   void EnableDAQLink_Lite(uint8_t iDAQLink,uint8_t enable);
+  void EnableDAQLink_Lite(WriteBatch & batch,uint8_t iDAQLink,uint8_t enable);
   void StartSyncDTS();
   void ResetWIBAndCfgDTS(uint8_t localClock,uint8_t PDTS_TGRP, uint8_t PDTSsource = 0, uint32_t PDTSAlignment_timeout = 0);
   void CheckedResetWIBAndCfgDTS(uint8_t localClock,uint8_t PDTS_TGRP, uint8_t PDTSsource = 0, uint32_t PDTSAlignment_timeout = 0);
   void StartStreamToDAQ(bool l1=true, bool l2=true, bool l3=false, bool l4=false);
   void PDTSInRunningState();
+  //PDTS lock acquisition (InitializeDTS): how often PDTS_STATE is polled, and the states the last one went through
+  struct PDTSTransition{
+    double time;    //seconds since the start of the acquisition
+    uint8_t state;  //PDTS_STATE (the first state of each phase attempt is always recorded)
+  };
+  void SetPDTSPollInterval(uint32_t us);
+  std::vector<PDTSTransition> const & GetPDTSTimeline(){return PDTSTimeline;}
 
   void EnableFEMBCNC();
   void DisableFEMBCNC();
@@ -68,7 +77,8 @@ class WIB: public WIBBase {
   void     SetDTS_SI5344Page(uint8_t page);
   uint8_t  GetDTS_SI5344Page();
   uint8_t  GetDTS_SI5344AddressPage(uint16_t address);
-  void     LoadConfigDTS_SI5344(std::string const & fileName);
+  //Write the configuration registers that differ from the chip's, false if none did (and nothing was written)
+  bool     LoadConfigDTS_SI5344(std::string const & fileName);
   void     ResetSi5344();
   void     SelectSI5344(uint64_t input, bool enable);
   void     SelectSI5342(uint64_t input, bool enable);
@@ -79,7 +89,8 @@ class WIB: public WIBBase {
   void     SetDAQ_SI5342Page(uint8_t page);
   uint8_t  GetDAQ_SI5342Page();
   uint8_t  GetDAQ_SI5342AddressPage(uint16_t address);
-  void     LoadConfigDAQ_SI5342(std::string const & fileName);
+  //Write the configuration registers that differ from the chip's, false if none did (and nothing was written)
+  bool     LoadConfigDAQ_SI5342(std::string const & fileName);
   void     ResetSi5342();
 
   //History debug
@@ -228,6 +239,19 @@ class WIB: public WIBBase {
   // Prevent copying of WIB objects
   WIB( const WIB& other) ; // prevents construction-copy
   WIB& operator=( const WIB&) ; // prevents copying
+  //Program an SI534x (chip is its base name, e.g. DTS.SI5344) from a ClockBuilder register script,
+  //writing only the configuration registers the chip doesn't already hold. False if there were none.
+  bool LoadConfigSI534x(std::string const & chip, std::string const & fileName, char const * defaultFileName);
+  //Poll PDTS_STATE until RUN, trying a new phase (SI5344 soft reset) when it stalls or errors. timeout_ms 0 is forever
+  void AcquirePDTSLock(uint32_t timeout_ms);
+  void SoftResetDTS_SI5344();
+  //WaitFor for the reset and clock steps (the wait log has every one). RequireWaitFor throws WIB_ERROR if the
+  //condition isn't met in time, for locks the following steps depend on; CheckWaitFor only prints a warning.
+  void RequireWaitFor(std::string_view address, uint32_t value, uint32_t timeout_us,
+		      uint32_t poll_interval_us = 1000, uint32_t hold_us = 0);
+  bool CheckWaitFor(std::string_view address, uint32_t value, uint32_t timeout_us,
+		    uint32_t poll_interval_us = 1000, uint32_t hold_us = 0);
+
   WIB_DAQ_t DAQMode;
   uint8_t FEMBCount;
   uint8_t FEMBStreamCount;
@@ -238,5 +262,8 @@ class WIB: public WIBBase {
   bool ContinueOnFEMBSPIError;
   bool ContinueOnFEMBSyncError; // if phase hunt fails keep going else raise exception
   bool ContinueIfListOfFEMBClockPhasesDontSync; // if true try to hunt for the phase else raise exception
+
+  uint32_t PDTSPollInterval; //us
+  std::vector<PDTSTransition> PDTSTimeline;
 };
 #endif
@@ -2,9 +2,13 @@
 #define __WIBBASE_HH__
 
 #include <string>
+#include <string_view>
+#include <functional>
 #include <stdint.h>
 
 #include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/WriteBatch.hh"
+#include <boost/unordered_map.hpp>
 
 #define FEMB_COUNT 4
 
@@ -17,21 +21,91 @@ public:
 
   uint32_t Read(uint16_t address);
   uint32_t ReadWithRetry(uint16_t address);
-  uint32_t Read(std::string const & address);
-  uint32_t ReadWithRetry(std::string const & address);
+  uint32_t Read(std::string_view address);
+  uint32_t ReadWithRetry(std::string_view address);
+  std::vector<uint32_t> Read(std::vector<uint16_t> const & addresses);
+  std::vector<uint32_t> ReadWithRetry(std::vector<uint16_t> const & addresses);
   void Write(uint16_t address,uint32_t value);
   void WriteWithRetry(uint16_t address,uint32_t value);
-  void Write(std::string const & address,uint32_t value);
-  void WriteWithRetry(std::string const & address,uint32_t value);
+  void Write(std::string_view address,uint32_t value);
+  void WriteWithRetry(std::string_view address,uint32_t value);
   void Write(uint16_t address,std::vector<uint32_t> const & values);
-  void Write(std::string const & address,std::vector<uint32_t> const & values);
+  void Write(std::string_view address,std::vector<uint32_t> const & values);
   void Write(uint16_t address,uint32_t const * values,size_t word_count);
-  void Write(std::string const & address,uint32_t const * values,size_t word_count);
+  void Write(std::string_view address,uint32_t const * values,size_t word_count);
 
+  //Resolve a name once, then access it without the name lookup
+  RegisterHandle Resolve(std::string_view address);
+  RegisterHandle ResolveFEMB(int iFEMB, std::string_view address);
+  uint32_t Read(RegisterHandle const & handle);
+  uint32_t ReadWithRetry(RegisterHandle const & handle);
+  void Write(RegisterHandle const & handle,uint32_t value);
+  void WriteWithRetry(RegisterHandle const & handle,uint32_t value);
+
+  //Stage field writes to merge into one write per register (see WriteBatch)
+  WriteBatch Batch();
+  WriteBatch FEMBBatch(int iFEMB);
+
+  //Typed access to WIB registers through the generated descriptors (see AddressTable::Read<>)
+  template<class REGISTER> uint32_t Read(){return wib->Read<REGISTER>();};
+  template<class REGISTER> uint32_t ReadWithRetry(){return wib->ReadWithRetry<REGISTER>();};
+  template<class REGISTER> void Write(uint32_t value){wib->Write<REGISTER>(value);};
+  template<class REGISTER> void WriteWithRetry(uint32_t value){wib->WriteWithRetry<REGISTER>(value);};
+
+
+  //Fields read with one bulk read of their registers (see AddressTable::Snapshot)
+  RegisterSnapshot Snapshot(std::string const & prefix, bool retry = false){
+    return wib->Snapshot(prefix,retry);
+  }
+  RegisterSnapshot SnapshotTagged(std::string const & tag, bool retry = false){
+    return wib->SnapshotTagged(tag,retry);
+  }
+  RegisterSnapshot SnapshotNames(std::vector<std::string> const & names, bool retry = false){
+    return wib->SnapshotNames(names,retry);
+  }
+  RegisterSnapshot FEMBSnapshot(int iFEMB, std::string const & prefix, bool retry = false);
 
   uint32_t ReadI2C(std::string const & base_address,uint16_t I2C_aaddress, uint8_t byte_count=4);
   void     WriteI2C(std::string const & base_address,uint16_t I2C_address, uint32_t data, uint8_t byte_count=4,bool ignore_error = false);
 
+  //One byte for a paged I2C device (e.g. the SI534x clock chips)
+  struct I2CPagedWrite{
+    uint8_t page;
+    uint8_t address;
+    uint8_t data;
+  };
+  //Write many bytes through the I2C master at base_address, selecting each page once by writing it to
+  //page_address.  Unless keep_order, the writes are grouped by page (keeping their order within a page).
+  //Each write is tried up to tries times; the indexes of the ones that still failed are returned, nothing is thrown
+  //for I2C errors.
+  std::vector<size_t> WriteI2CBurst(std::string const & base_address, std::vector<I2CPagedWrite> const & writes,
+				    bool keep_order = false, uint8_t page_address = 0x01, int tries = 10);
+  //Read the current value of each register into its data, selecting each page once and reading up to
+  //max_bytes consecutive addresses per transaction.  Throws on an I2C error.
+  //max_bytes > 1 assumes the first byte comes back in the low bits of RD_DATA, which is not confirmed
+  //for the firmware's I2C master, so only use it where a wrong pairing can't go unnoticed.
+  void ReadI2CBurst(std::string const & base_address, std::vector<I2CPagedWrite> & registers,
+		    uint8_t page_address = 0x01, uint8_t max_bytes = 1);
+
+  //Poll a register until predicate(value) holds or timeout_us has passed, true if it held.
+  //With hold_us, predicate must hold on every read for at least hold_us: use it after a reset or clock
+  //switch, where the old status can still read as good before the PLL drops lock.
+  //Each wait is printed and kept in the wait log with its time and number of reads (WIB clears the log
+  //at the start of each ResetWIBAndCfgDTS and CheckedResetWIBAndCfgDTS).
+  bool WaitFor(std::string_view address, std::function<bool(uint32_t)> const & predicate,
+	       uint32_t timeout_us, uint32_t poll_interval_us = 1000, uint32_t hold_us = 0);
+  //Wait for the register to read value
+  bool WaitFor(std::string_view address, uint32_t value, uint32_t timeout_us, uint32_t poll_interval_us = 1000,
+	       uint32_t hold_us = 0);
+  struct WaitRecord{
+    std::string address;
+    double time;     //seconds
+    uint32_t reads;
+    bool met;        //false if it timed out
+  };
+  std::vector<WaitRecord> const & GetWaitLog(){return waitLog;}
+  void ClearWaitLog(){waitLog.clear();}
+
   std::vector<std::string> GetNames(std::string const & regex){
     return wib->GetNames(regex);
   }
@@ -58,14 +132,28 @@ public:
 
 
   uint32_t ReadFEMB(int iFEMB, uint16_t address);
-  uint32_t ReadFEMB(int iFEMB, std::string const & address);
+  uint32_t ReadFEMB(int iFEMB, std::string_view address);
+  std::vector<uint32_t> ReadFEMB(int iFEMB, std::vector<uint16_t> const & addresses);
   void WriteFEMB(int iFEMB, uint16_t address, uint32_t value);
-  void WriteFEMB(int iFEMB, std::string const & address, uint32_t value);
+  void WriteFEMB(int iFEMB, std::string_view address, uint32_t value);
+  uint32_t ReadFEMB(int iFEMB, RegisterHandle const & handle);
+  void WriteFEMB(int iFEMB, RegisterHandle const & handle, uint32_t value);
+  void WriteFEMB(int iFEMB, uint16_t address, std::vector<uint32_t> const & values);
   void WriteFEMBBits(int iFEMB, uint16_t address, uint32_t pos, uint32_t mask, uint32_t value);
   void EnableADC(uint64_t iFEMB, uint64_t enable);
 
-  Item const * GetItem(std::string const &);
-  Item const * GetFEMBItem(int iFEMB,std::string const &);
+  Item const * GetItem(std::string_view);
+  Item const * GetFEMBItem(int iFEMB,std::string_view);
+
+  //Skip the read of read-modify-write field writes by remembering register values (see AddressTable::EnableShadow).
+  //Invalidate after anything that resets registers behind the software's back.
+  void EnableShadowRegisters(bool enable);
+  void InvalidateShadowRegisters();
+  void InvalidateFEMBShadowRegisters(int iFEMB);
+
+  //Transport counters and latency histograms for the WIB and FEMB (1-4) register ports
+  BNL_UDP_Stats const & GetTransportStats();
+  BNL_UDP_Stats const & GetFEMBTransportStats(int iFEMB);
 
   int GetSVNVersion(){return Version;}
 private:  
@@ -76,6 +164,37 @@ private:
   
   AddressTable * wib;
   AddressTable * FEMB[FEMB_COUNT];
+
+  //Registers of an I2C master, resolved on first use of each base address
+  struct I2CRegisters{
+    RegisterHandle rw;
+    RegisterHandle addr;
+    RegisterHandle byte_count;
+    RegisterHandle wr_data;
+    RegisterHandle rd_data;
+    RegisterHandle done;
+    RegisterHandle run;
+    RegisterHandle error;
+    RegisterHandle reset;
+    //Every control field (RW, ADDR, BYTE_COUNT, RUN, DONE, ERROR, RESET) is in one register,
+    //so a transaction is set up with full word writes and polled with one read
+    bool singleShot;
+    //Our last transaction finished, no need to wait for DONE before the next RUN
+    bool idle;
+  };
+  boost::unordered_map<std::string,I2CRegisters> i2cRegisters;
+  std::vector<WaitRecord> waitLog;
+  I2CRegisters & GetI2CRegisters(std::string const & base_address);
+  //Single shot I2C: set up, run and poll with full word accesses of the control register
+  uint32_t I2CControlWord(I2CRegisters const & i2c, bool read, uint16_t I2C_address, uint8_t byte_count);
+  //Poll the control register (into control) until DONE, false if it doesn't come within I2C_DONE_TIMEOUT_US
+  bool WaitI2CDone(I2CRegisters const & i2c, uint32_t & control, uint32_t * rd_data = NULL);
+  //Write and wait for DONE, false on an I2C error or timeout. With block, the control and data words go in one
+  //block write, and are written again one at a time if it isn't acknowledged
+  bool SingleShotWriteI2C(I2CRegisters & i2c, uint16_t I2C_address, uint32_t data, uint8_t byte_count, bool block);
+  //One byte of a burst, false if it failed
+  bool TryWriteI2C(I2CRegisters & i2c, std::string const & base_address, uint8_t I2C_address, uint8_t data);
+  void ThrowI2CError(I2CRegisters const & i2c, std::string const & base_address, char const * trans_info);
   static const int Version; //SVN version
   const float FEMBReadSleepTime;
   const float FEMBWriteSleepTime;
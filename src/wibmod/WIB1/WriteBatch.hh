@@ -0,0 +1,48 @@
+#ifndef __WRITEBATCH_HH__
+#define __WRITEBATCH_HH__
+
+#include <string_view>
+#include <vector>
+
+#include <stdint.h>
+
+#include "wibmod/WIB1/AddressTable.hh"
+
+//Field writes staged against one AddressTable and sent together by Commit().
+//Fields that share a register are merged into one write of that register, so
+//  batch.Write("DTS.CONVERT_CONTROL.HALT",1);
+//  batch.Write("DTS.CONVERT_CONTROL.ENABLE",0);
+//  batch.Commit();
+//costs one read and one write of 0x205 instead of two of each.
+//Registers are written in the order they were first staged.  Staging a field that overlaps
+//one already staged in its register starts a new write of that register after the others,
+//so writing a field twice (e.g. a reset set and then cleared) still does both writes.
+//The registers that need their other bits are read with one bulk read (or taken from the
+//shadow, see AddressTable::EnableShadow) and runs of consecutive registers are block written.
+class WriteBatch{
+public:
+  WriteBatch(AddressTable * table);
+  WriteBatch & Write(std::string_view registerName,uint32_t val);
+  WriteBatch & Write(RegisterHandle const & handle,uint32_t val);
+  template<class REGISTER> WriteBatch & Write(uint32_t val){return Write(table->Resolve<REGISTER>(),val);};
+
+  //Send the staged writes and empty the batch.
+  //With retry, the reads and writes use the ...WithRetry transport calls (no block writes)
+  void Commit(bool retry = false);
+  size_t Size() const {return entries.size();};
+  bool Empty() const {return entries.empty();};
+  void Clear(){entries.clear();};
+private:
+  WriteBatch();
+
+  struct Entry{
+    uint16_t address;
+    uint32_t mask;   //bits staged
+    uint32_t value;  //staged bits, already shifted into place
+    uint32_t action; //staged action bits, which read back as 0
+  };
+  AddressTable * table;
+  std::vector<Entry> entries;
+};
+
+#endif
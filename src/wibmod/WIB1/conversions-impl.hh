@@ -12,12 +12,12 @@ DEFINE_CONVERSION_CLASS(
 public:
   void init (unordered_map<std::string, std::string> params) {
     (void) params; // to make compiler not complain about unused arguments
+    kind = PASS;
     data_size = sizeof(uint32_t);
     data_description = "i";
   }
   void Convert(uint32_t src, void *dest) {
-    uint32_t *val = (uint32_t *)dest;
-    *val = src;
+    memcpy(dest, &src, sizeof(src));
   }
 ))
 
@@ -28,6 +28,7 @@ DEFINE_CONVERSION_CLASS(
   double offset;
 public:
   void init (unordered_map<std::string, std::string> params) {
+    kind = LINEAR;
     data_size = sizeof(double);
     data_description = "d";
     std::string scale_str = params["scale"];
@@ -36,17 +37,25 @@ public:
     sscanf(offset_str.c_str(), "%le", &offset);
   };
   void Convert(uint32_t src, void *dest) {
-    double *val = (double *)dest;
-    *val = ((double)src) * scale + offset;
+    double val = ((double)src) * scale + offset;
+    memcpy(dest, &val, sizeof(val));
   }
+  double Scale() const {return scale;}
+  double Offset() const {return offset;}
 ))
 
 DEFINE_CONVERSION_CLASS(
   enum,
 (
-  unordered_map<uint32_t, std::string> names;
+  // the names in value order, each padded with null bytes to data_size in table
+  std::vector<uint32_t> values;
+  std::vector<char> table;
+  // index into values by value, when the values are small
+  std::vector<int32_t> dense;
 public:
   void init (unordered_map<std::string, std::string> params) {
+    kind = ENUM;
+    std::map<uint32_t, std::string> names;
     size_t length = 16; // enough for "???? 0x00000000\0"
     BOOST_FOREACH( STRIP((std::pair<std::string, std::string>)) i, params ) {
       long int number = 0;
@@ -65,13 +74,34 @@ public:
     char descr[descrlen];
     snprintf(descr, descrlen, "c:%zu;", length);
     data_description = std::string(descr);
+    table.assign(names.size() * data_size, '\0');
+    BOOST_FOREACH( STRIP((std::pair<uint32_t, std::string>)) i, names ) {
+      memcpy(&table[values.size() * data_size], i.second.data(), i.second.size());
+      values.push_back(i.first);
+    }
+    if (!values.empty() && values.back() < 256) {
+      dense.assign(values.back() + 1, -1);
+      for (size_t iValue = 0; iValue < values.size(); iValue++) {
+        dense[values[iValue]] = iValue;
+      }
+    }
   };
+  // padded name of src, NULL if it has none
+  char const * Lookup(uint32_t src) const {
+    if (!dense.empty()) {
+      if (src >= dense.size() || dense[src] < 0) return NULL;
+      return &table[dense[src] * data_size];
+    }
+    std::vector<uint32_t>::const_iterator it =
+      std::lower_bound(values.begin(), values.end(), src);
+    if (it == values.end() || *it != src) return NULL;
+    return &table[(it - values.begin()) * data_size];
+  }
   void Convert(uint32_t src, void *dest) {
     char *val = (char *)dest;
-    if (names.count(src)) {
-      std::string name = names[src];
-      // strncpy pads to end of buffer with null byte
-      strncpy(val, name.c_str(), data_size);
+    char const *name = Lookup(src);
+    if (name) {
+      memcpy(val, name, data_size);
     } else {
       // due to snprintf limitation we can't write to the last byte
       //   thus the formatted string uses 15 out of 16 characters
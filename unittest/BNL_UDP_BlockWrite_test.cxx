@@ -0,0 +1,130 @@
+/**
+ * @file BNL_UDP_BlockWrite_test.cxx
+ *
+ * Multi-word writes through BNL_UDP against BNL_UDP_Emulator, with firmware that takes block
+ * writes and with firmware that ignores them (wib1_emulator -n).
+ * Needs $WIBMOD_SHARE to find the address tables.
+ */
+#define BOOST_TEST_MODULE BNL_UDP_BlockWrite_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include "wibmod/WIB1/AddressTable.hh"
+#include "wibmod/WIB1/BNL_UDP.hh"
+#include "wibmod/WIB1/BNL_UDP_Emulator.hh"
+#include "wibmod/WIB1/BNL_UDP_Exception.hh"
+#include "wibmod/WIB1/RegisterModel.hh"
+
+#include <vector>
+
+//Well away from the ports a real emulator or WIB on this host would use
+#define TEST_PORT_OFFSET 0x70
+//Plain memory in the model (not in WIB.adt)
+#define TEST_BLOCK_ADDRESS 0x6000
+#define TEST_BLOCK_WORDS 300
+
+BOOST_AUTO_TEST_SUITE(BNL_UDP_BlockWrite_test)
+
+struct EmulatedWIB
+{
+  explicit EmulatedWIB(bool block_write)
+    : table("WIB.adt", "mem://block_write_test", 0)
+  {
+    model.Seed(table);
+    emulator = new BNL_UDP_Emulator(model, TEST_PORT_OFFSET);
+    emulator->SetBlockWrite(block_write);
+    emulator->Start();
+    udp.Setup("127.0.0.1", TEST_PORT_OFFSET);
+    udp.SetWriteAck(true);
+    // Keep the unanswered blocks short
+    udp.SetTimeout(100000);
+  }
+  ~EmulatedWIB()
+  {
+    emulator->Stop();
+    delete emulator;
+  }
+
+  std::vector<uint32_t> block() const
+  {
+    std::vector<uint32_t> values(TEST_BLOCK_WORDS);
+    for (size_t i = 0; i < values.size(); ++i)
+      values[i] = 0xB10C0000 + i;
+    return values;
+  }
+  std::vector<uint32_t> read_back()
+  {
+    std::vector<uint16_t> addresses(TEST_BLOCK_WORDS);
+    for (size_t i = 0; i < addresses.size(); ++i)
+      addresses[i] = TEST_BLOCK_ADDRESS + i;
+    return udp.ReadWithRetry(addresses);
+  }
+
+  AddressTable table;
+  RegisterModel model;
+  BNL_UDP_Emulator* emulator;
+  BNL_UDP udp;
+};
+
+BOOST_AUTO_TEST_CASE(ProbeLatchesBlockWrites)
+{
+  EmulatedWIB wib(true);
+  wib.udp.TableLoaded(wib.table);
+  uint32_t version = wib.udp.ReadWithRetry(wib.table.GetItem("SYSTEM.FW_VERSION")->address);
+  BOOST_REQUIRE(wib.udp.GetBlockWriteMode() == BNL_UDP::BLOCK_WRITE_PROBE);
+
+  wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block());
+  BOOST_CHECK(wib.udp.GetBlockWriteMode() == BNL_UDP::BLOCK_WRITE_ON);
+  BOOST_CHECK(wib.read_back() == wib.block());
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().per_word_writes.load(), 0);
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().block_write_failures.load(), 0);
+  // The probe only wrote read-only registers
+  BOOST_CHECK_EQUAL(wib.udp.ReadWithRetry(wib.table.GetItem("SYSTEM.FW_VERSION")->address), version);
+}
+
+BOOST_AUTO_TEST_CASE(ProbeLatchesPerWordWrites)
+{
+  EmulatedWIB wib(false);
+  wib.udp.TableLoaded(wib.table);
+
+  wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block());
+  BOOST_CHECK(wib.udp.GetBlockWriteMode() == BNL_UDP::BLOCK_WRITE_OFF);
+  BOOST_CHECK(wib.read_back() == wib.block());
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().per_word_writes.load(), 1);
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().block_write_failures.load(), 0);
+
+  // Latched: the next write doesn't probe again
+  uint64_t sent = wib.udp.GetStats().packets_sent.load();
+  wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block());
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().packets_sent.load() - sent, TEST_BLOCK_WORDS);
+}
+
+BOOST_AUTO_TEST_CASE(ForcedBlockWritesOnFirmwareWithout)
+{
+  EmulatedWIB wib(false);
+  wib.udp.SetBlockWrite(true);
+
+  BOOST_CHECK_THROW(wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block()), BUException::BAD_REPLY);
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().block_write_failures.load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(ForcedPerWordWrites)
+{
+  EmulatedWIB wib(true);
+  wib.udp.SetBlockWrite(false);
+
+  wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block());
+  BOOST_CHECK(wib.read_back() == wib.block());
+  BOOST_CHECK_EQUAL(wib.udp.GetStats().per_word_writes.load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(NoTableKeepsBlockWrites)
+{
+  EmulatedWIB wib(true);
+
+  wib.udp.Write(TEST_BLOCK_ADDRESS, wib.block());
+  BOOST_CHECK(wib.udp.GetBlockWriteMode() == BNL_UDP::BLOCK_WRITE_ON);
+  BOOST_CHECK(wib.read_back() == wib.block());
+}
+
+BOOST_AUTO_TEST_SUITE_END()